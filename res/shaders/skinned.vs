@@ -0,0 +1,25 @@
+#version 330 core
+
+// Pass-through for vertices skinned once per frame, by transform feedback (Model::SkinToFeedback)
+// or by the compute skinning shader (ComputeSkinner)
+
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec3 aNormal;
+layout(location = 2) in vec2 aTexCoords;
+
+out vec3 Normal;
+out vec3 FragPos;
+out vec2 TexCoord;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+void main() {
+	TexCoord = aTexCoords;
+
+	// same outputs as vertex.shader, the normal stays in skinned space there as well
+	FragPos = vec3(model * vec4(aPos, 1.0));
+	Normal = aNormal;
+	gl_Position = projection * view * vec4(FragPos, 1.0);
+}
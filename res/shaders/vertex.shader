@@ -3,22 +3,81 @@
 layout(location = 0) in vec3 aPos;
 layout(location = 1) in vec3 aNormal;
 layout(location = 2) in vec2 aTexCoords;
-layout(location = 3) in ivec4 BoneIDs;
+// 8 or 16-bit indices and normalized weights (BoneEncoding), Weights2.w is never stored
+layout(location = 3) in uvec4 BoneIDs;
 layout(location = 4) in vec4 Weights;
+// influences 4 to 7
+layout(location = 5) in uvec4 BoneIDs2;
+layout(location = 6) in vec4 Weights2;
 
 out vec3 Normal;
 out vec3 FragPos;
 out vec2 TexCoord;
 
+// SKINNING_LBS, SKINNING_DQS or SKINNING_HYBRID compile only the math of one method (Shader
+// defines). Without any of them the lbsOn / dqsOn / ratio uniforms pick it per draw.
+#if defined(SKINNING_LBS) || defined(SKINNING_DQS) || defined(SKINNING_HYBRID)
+#define SKINNING_VARIANT
+#endif
+#if !defined(SKINNING_VARIANT) || defined(SKINNING_LBS) || defined(SKINNING_HYBRID)
+#define SKINNING_USES_LBS
+#endif
+#if !defined(SKINNING_VARIANT) || defined(SKINNING_DQS) || defined(SKINNING_HYBRID)
+#define SKINNING_USES_DQS
+#endif
+
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
-// Match the current model's bone count (151) while staying under macOS uniform limits.
-uniform mat4 gBones[151];
-uniform mat2x4 dqs[151];
-uniform bool lbsOn;
-uniform bool dqsOn;
-uniform float ratio;
+// influences read per vertex, 1, 2, 4 or 8: Mesh draws one range per influence bucket
+uniform int numInfluences;
+
+int BoneID(int i) {
+	return int(i < 4 ? BoneIDs[i] : BoneIDs2[i - 4]);
+}
+
+// weight of influence i, the last one read takes what the others leave of 1
+float Weight(int i, inout float remaining) {
+	float w = i < numInfluences - 1 ? (i < 4 ? Weights[i] : Weights2[i - 4]) : remaining;
+	remaining -= w;
+	return w;
+}
+// Bone palettes of all instances in one RGBA32F texture buffer filled by BonePalette, so the
+// bone count is not bound by uniform limits. A matrix is 3 texels, the rows of its affine part,
+// and a dual quaternion 2 (real, dual), counted from the base texels of the instance drawn.
+uniform samplerBuffer bonePalette;
+
+#ifdef SKINNING_USES_LBS
+uniform int boneMatricesBase;
+
+// the 3 stored rows, blended before the constant last row is put back by AffineMatrix
+mat3x4 BoneMatrix(int bone) {
+	int texel = boneMatricesBase + 3 * bone;
+	return mat3x4(texelFetch(bonePalette, texel), texelFetch(bonePalette, texel + 1),
+	              texelFetch(bonePalette, texel + 2));
+}
+
+mat4 AffineMatrix(mat3x4 rows) {
+	return transpose(mat4(rows[0], rows[1], rows[2], vec4(0.0, 0.0, 0.0, 1.0)));
+}
+
+mat4 LinearBlend() {
+	float remaining = 1.0;
+	mat3x4 BoneTransform = BoneMatrix(BoneID(0)) * Weight(0, remaining);
+	for (int i = 1; i < numInfluences; ++i) {
+		BoneTransform += BoneMatrix(BoneID(i)) * Weight(i, remaining);
+	}
+	return AffineMatrix(BoneTransform);
+}
+#endif
+
+#ifdef SKINNING_USES_DQS
+uniform int boneDualQuatsBase;
+
+mat2x4 BoneDualQuat(int bone) {
+	int texel = boneDualQuatsBase + 2 * bone;
+	return mat2x4(texelFetch(bonePalette, texel), texelFetch(bonePalette, texel + 1));
+}
 
 mat4x4 DQtoMat(vec4 real, vec4 dual) {
 	mat4x4 m;
@@ -49,57 +108,75 @@ mat4x4 DQtoMat(vec4 real, vec4 dual) {
 	return m;
 }
 
-void main() {
-
-
-	TexCoord = aTexCoords;
-
-	mat4 BoneTransform = gBones[BoneIDs[0]] * Weights[0];
-	BoneTransform += gBones[BoneIDs[1]] * Weights[1];
-	BoneTransform += gBones[BoneIDs[2]] * Weights[2];
-	BoneTransform += gBones[BoneIDs[3]] * Weights[3];
-
-	mat2x4 dq0 = dqs[BoneIDs[0]];
-	mat2x4 dq1 = dqs[BoneIDs[1]];
-	mat2x4 dq2 = dqs[BoneIDs[2]];
-	mat2x4 dq3 = dqs[BoneIDs[3]];
+mat2x4 DualQuatBlend() {
+	float remaining = 1.0;
+	mat2x4 dq0 = BoneDualQuat(BoneID(0));
+	mat2x4 blendDQ = dq0 * Weight(0, remaining);
+	for (int i = 1; i < numInfluences; ++i) {
+		mat2x4 dq = BoneDualQuat(BoneID(i));
+		if (dot(dq0[0], dq[0]) < 0.0) dq *= -1.0;
+		blendDQ += dq * Weight(i, remaining);
+	}
 
-	if (dot(dq0[0], dq1[0]) < 0.0) dq1 *= -1.0;
-	if (dot(dq0[0], dq2[0]) < 0.0) dq2 *= -1.0;
-	if (dot(dq0[0], dq3[0]) < 0.0) dq3 *= -1.0;
+	float len = length(blendDQ[0]);
+	if (len > 0.0) {
+		blendDQ /= len;
+	}
 
-mat2x4 blendDQ = dq0 * Weights[0];
-blendDQ += dq1 * Weights[1];
-blendDQ += dq2 * Weights[2];
-blendDQ += dq3 * Weights[3];
+	return blendDQ;
+}
 
-float len = length(blendDQ[0]);
-if (len > 0.0) {
-	blendDQ /= len;
+// a unit dual quaternion is a rigid motion, the normal only needs the rotation of its real part
+vec3 RotateNormal(vec4 real, vec3 n) {
+	return n + 2.0 * cross(real.xyz, cross(real.xyz, n) + real.w * n);
 }
+#endif
+
+// inverse transpose of the upper 3x3 of M without a 4x4 inverse: the cofactor matrix, whose
+// columns are cross products of the columns of M, over the determinant
+vec3 CofactorNormal(mat4 M, vec3 n) {
+	mat3 A = mat3(M);
+	mat3 cofactor = mat3(cross(A[1], A[2]), cross(A[2], A[0]), cross(A[0], A[1]));
+	return cofactor * n / dot(A[0], cofactor[0]);
+}
+
+uniform bool lbsOn;
+uniform bool dqsOn;
+uniform float ratio;
 
-mat4x4 DQmat = DQtoMat(blendDQ[0], blendDQ[1]);
+void main() {
+	TexCoord = aTexCoords;
 
+#if defined(SKINNING_LBS)
+	mat4 M = LinearBlend();
+	Normal = CofactorNormal(M, aNormal);
+#elif defined(SKINNING_DQS)
+	mat2x4 dq = DualQuatBlend();
+	mat4 M = DQtoMat(dq[0], dq[1]);
+	Normal = RotateNormal(dq[0], aNormal);
+#elif defined(SKINNING_HYBRID)
+	mat2x4 dq = DualQuatBlend();
+	mat4 M = (1 - ratio) * LinearBlend() + ratio * DQtoMat(dq[0], dq[1]);
+	Normal = CofactorNormal(M, aNormal);
+#else
+	mat4 M;
 	if (lbsOn) {
-		vec4 pos = BoneTransform * vec4(aPos, 1.0);
-		gl_Position = projection * view * model * pos;
-		FragPos = vec3(model* pos);
-		Normal = mat3(transpose(inverse(BoneTransform))) * aNormal;
+		M = LinearBlend();
+		Normal = CofactorNormal(M, aNormal);
 	}
-	else if (dqsOn)
-	{
-		vec4 pos = DQmat * vec4(aPos, 1.0);
-		gl_Position = projection * view * model * pos;
-		FragPos = vec3(model * pos);
-		Normal = mat3(transpose(inverse(DQmat))) * aNormal;
+	else if (dqsOn) {
+		mat2x4 dq = DualQuatBlend();
+		M = DQtoMat(dq[0], dq[1]);
+		Normal = RotateNormal(dq[0], aNormal);
 	}
 	else {
-		mat4 Mix = (1 - ratio) * BoneTransform + ratio * DQmat;
-		vec4 pos = Mix * vec4(aPos, 1.0);
-		gl_Position = projection * view * model * pos;
-		FragPos = vec3(model* pos);
-		Normal = mat3(transpose(inverse(Mix))) * aNormal;
+		mat2x4 dq = DualQuatBlend();
+		M = (1 - ratio) * LinearBlend() + ratio * DQtoMat(dq[0], dq[1]);
+		Normal = CofactorNormal(M, aNormal);
 	}
+#endif
 
-	
-}
\ No newline at end of file
+	vec4 pos = M * vec4(aPos, 1.0);
+	gl_Position = projection * view * model * pos;
+	FragPos = vec3(model * pos);
+}
@@ -0,0 +1,778 @@
+#include "AnimationClip.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+namespace
+{
+// number of keys stepped over linearly before falling back to a binary search
+const unsigned int MAX_CURSOR_STEPS = 4;
+
+// returns the index i of the key interval with i_times[i] <= i_time < i_times[i + 1].
+// The search starts at the cursor, so forward playback is amortized O(1). Seeks, loop wraps and
+// reverse playback fall back to a binary search.
+unsigned int FindKey(float i_time, const std::vector<float>& i_times, unsigned int& io_cursor)
+{
+    assert(i_times.size() > 1);
+    const unsigned int last = static_cast<unsigned int>(i_times.size()) - 1;
+
+    unsigned int i = io_cursor < last ? io_cursor : 0;
+    if (i == 0 || i_times[i] <= i_time)
+    {
+        for (unsigned int step = 0; step <= MAX_CURSOR_STEPS && i < last; ++step, ++i)
+        {
+            if (i_time < i_times[i + 1])
+            {
+                io_cursor = i;
+                return i;
+            }
+        }
+    }
+
+    // first key after i_time, the interval starts one key before it
+    auto next = std::upper_bound(i_times.begin() + 1, i_times.end(), i_time);
+    if (next == i_times.end())
+    {
+        assert(0);
+        return 0;
+    }
+
+    io_cursor = static_cast<unsigned int>(next - i_times.begin()) - 1;
+    return io_cursor;
+}
+
+// the three smallest components of a unit quaternion lie in [-1/sqrt(2), 1/sqrt(2)]
+const float QUAT_COMPONENT_RANGE = 0.70710678f;
+const float QUAT_COMPONENT_MAX = 32767.0f;
+// compressed channels decoded at once by AnimationClip::SamplePose, on the stack
+const unsigned int UNPACK_BLOCK_SIZE = 64;
+
+PackedQuat PackQuat(const glm::quat& i_rotation)
+{
+    float components[4] = {i_rotation.x, i_rotation.y, i_rotation.z, i_rotation.w};
+
+    unsigned int largest = 0;
+    for (unsigned int i = 1; i < 4; ++i)
+    {
+        if (std::abs(components[i]) > std::abs(components[largest]))
+        {
+            largest = i;
+        }
+    }
+
+    // q and -q are the same rotation, make the dropped component positive
+    const float sign = components[largest] < 0.0f ? -1.0f : 1.0f;
+
+    uint16_t packed[3];
+    for (unsigned int i = 0, j = 0; i < 4; ++i)
+    {
+        if (i == largest)
+        {
+            continue;
+        }
+        float unit = (sign * components[i] / QUAT_COMPONENT_RANGE) * 0.5f + 0.5f;
+        unit = std::min(std::max(unit, 0.0f), 1.0f);
+        packed[j++] = static_cast<uint16_t>(std::lround(unit * QUAT_COMPONENT_MAX));
+    }
+
+    PackedQuat result;
+    result.data[0] = static_cast<uint16_t>(packed[0] | ((largest & 1u) << 15));
+    result.data[1] = static_cast<uint16_t>(packed[1] | ((largest >> 1) << 15));
+    result.data[2] = packed[2];
+    return result;
+}
+
+// Decodes i_count rotations whose data[k] are stored in plane k, the planes i_stride apart.
+// Branch free, the dropped component is put back with selects instead of a table lookup, so the
+// loop vectorizes over a frame of channels (GCC and Clang need -fno-math-errno for the sqrt).
+void UnpackQuats(const uint16_t* i_planes, size_t i_stride, unsigned int i_count, float* o_x,
+                 float* o_y, float* o_z, float* o_w)
+{
+    const float scale = 2.0f * QUAT_COMPONENT_RANGE / QUAT_COMPONENT_MAX;
+    const uint16_t* data0 = i_planes;
+    const uint16_t* data1 = i_planes + i_stride;
+    const uint16_t* data2 = i_planes + 2 * i_stride;
+
+    for (unsigned int i = 0; i < i_count; ++i)
+    {
+        const unsigned int largest = (data0[i] >> 15) | ((data1[i] >> 15) << 1);
+        const float a = (data0[i] & 0x7FFF) * scale - QUAT_COMPONENT_RANGE;
+        const float b = (data1[i] & 0x7FFF) * scale - QUAT_COMPONENT_RANGE;
+        const float c = data2[i] * scale - QUAT_COMPONENT_RANGE;
+        const float d = std::sqrt(std::max(0.0f, 1.0f - a * a - b * b - c * c));
+
+        // the three smallest fill x, y, z, w in order, skipping the dropped one
+        float y = largest == 0 ? a : b;
+        y = largest == 1 ? d : y;
+        float z = largest <= 1 ? b : c;
+        z = largest == 2 ? d : z;
+        o_x[i] = largest == 0 ? d : a;
+        o_y[i] = y;
+        o_z[i] = z;
+        o_w[i] = largest == 3 ? d : c;
+    }
+}
+
+glm::quat UnpackQuat(const uint16_t* i_planes, size_t i_stride)
+{
+    float x, y, z, w;
+    UnpackQuats(i_planes, i_stride, 1, &x, &y, &z, &w);
+    return glm::quat(w, x, y, z);
+}
+
+QuantizationRange MakeRange(const std::vector<glm::vec3>& i_stream, unsigned int i_channel,
+                            unsigned int i_stride)
+{
+    glm::vec3 lower(std::numeric_limits<float>::max());
+    glm::vec3 upper(-std::numeric_limits<float>::max());
+    for (size_t i = i_channel; i < i_stream.size(); i += i_stride)
+    {
+        lower = glm::min(lower, i_stream[i]);
+        upper = glm::max(upper, i_stream[i]);
+    }
+
+    QuantizationRange range;
+    range.min = lower;
+    range.scale = (upper - lower) / 65535.0f;
+    return range;
+}
+
+PackedVec3 PackVec3(const glm::vec3& i_value, const QuantizationRange& i_range)
+{
+    PackedVec3 result;
+    for (unsigned int i = 0; i < 3; ++i)
+    {
+        float unit = i_range.scale[i] > 0.0f ? (i_value[i] - i_range.min[i]) / i_range.scale[i]
+                                             : 0.0f;
+        unit = std::min(std::max(unit, 0.0f), 65535.0f);
+        result.data[i] = static_cast<uint16_t>(std::lround(unit));
+    }
+    return result;
+}
+
+glm::vec3 UnpackVec3(const PackedVec3& i_packed, const QuantizationRange& i_range)
+{
+    return i_range.min +
+           glm::vec3(i_packed.data[0], i_packed.data[1], i_packed.data[2]) * i_range.scale;
+}
+//----------------------------------------------------------------
+
+// flag the channel as constant when all of its rotation and position keys match the first one
+void FoldConstantChannel(AnimationChannel& io_channel)
+{
+    io_channel.constant = false;
+    if (io_channel.rotations.empty() || io_channel.positions.empty())
+    {
+        return;
+    }
+
+    for (const glm::quat& rotation : io_channel.rotations)
+    {
+        if (!NearlyEqual(rotation, io_channel.rotations[0]))
+        {
+            return;
+        }
+    }
+
+    for (const glm::vec3& position : io_channel.positions)
+    {
+        if (!NearlyEqual(position, io_channel.positions[0]))
+        {
+            return;
+        }
+    }
+
+    io_channel.constant = true;
+    io_channel.constantRotation = io_channel.rotations[0];
+    io_channel.constantPosition = io_channel.positions[0];
+}
+} // namespace
+
+//----------------------------------------------------------------
+
+AnimationClip::AnimationClip(const aiAnimation* i_animation, const nodeAnimationMap& i_channels,
+                             const Rig& i_rig)
+{
+    m_name = i_animation->mName.data;
+    m_ticksPerSecond =
+        i_animation->mTicksPerSecond != 0 ? (float)i_animation->mTicksPerSecond : 25.0f;
+    m_duration = (float)i_animation->mDuration;
+
+    // channels are stored in rig order so evaluation walks them front to back
+    const std::vector<RigNode>& nodes = i_rig.GetNodes();
+    m_nodeChannels.assign(nodes.size(), NO_CHANNEL);
+
+    for (unsigned int i = 0; i < nodes.size(); ++i)
+    {
+        auto it = i_channels.find(nodes[i].name);
+        if (it == i_channels.end() || it->second == nullptr)
+        {
+            continue;
+        }
+
+        const aiNodeAnim* pNodeAnim = it->second;
+        AnimationChannel channel;
+        channel.node = i;
+
+        for (unsigned int k = 0; k < pNodeAnim->mNumPositionKeys; ++k)
+        {
+            const aiVectorKey& key = pNodeAnim->mPositionKeys[k];
+            channel.positionTimes.push_back((float)key.mTime);
+            channel.positions.push_back(glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z));
+        }
+
+        for (unsigned int k = 0; k < pNodeAnim->mNumRotationKeys; ++k)
+        {
+            const aiQuatKey& key = pNodeAnim->mRotationKeys[k];
+            channel.rotationTimes.push_back((float)key.mTime);
+            channel.rotations.push_back(
+                glm::quat(key.mValue.w, key.mValue.x, key.mValue.y, key.mValue.z));
+        }
+
+        for (unsigned int k = 0; k < pNodeAnim->mNumScalingKeys; ++k)
+        {
+            const aiVectorKey& key = pNodeAnim->mScalingKeys[k];
+            channel.scalingTimes.push_back((float)key.mTime);
+            channel.scalings.push_back(glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z));
+        }
+
+        // only the keys of the file count towards the end time
+        for (const std::vector<float>* times :
+             {&channel.positionTimes, &channel.rotationTimes, &channel.scalingTimes})
+        {
+            if (!times->empty())
+            {
+                m_endTime = std::max(m_endTime, times->back());
+            }
+        }
+
+        // Assimp allows a channel without keys of a kind, the node then holds its bind pose for
+        // it. A single key stands in, so sampling never sees an empty stream.
+        if (channel.positions.empty())
+        {
+            channel.positionTimes.push_back(0.0f);
+            channel.positions.push_back(nodes[i].bindTranslation);
+        }
+        if (channel.rotations.empty())
+        {
+            channel.rotationTimes.push_back(0.0f);
+            channel.rotations.push_back(nodes[i].bindRotation);
+        }
+        if (channel.scalings.empty())
+        {
+            channel.scalingTimes.push_back(0.0f);
+            channel.scalings.push_back(glm::vec3(1.0f));
+        }
+
+        FoldConstantChannel(channel);
+        m_numConstantChannels += channel.constant ? 1 : 0;
+
+        m_nodeChannels[i] = static_cast<unsigned int>(m_channels.size());
+        m_channels.push_back(channel);
+    }
+
+    if (m_duration <= 0.0f)
+    {
+        m_duration = m_endTime;
+    }
+}
+
+//----------------------------------------------------------------
+
+void AnimationClip::SampleChannel(unsigned int i_channel, float i_animationTime,
+                                  KeyCursor& io_cursor, glm::quat& o_rotation,
+                                  glm::vec3& o_translation) const
+{
+    const AnimationChannel& channel = m_channels[i_channel];
+    if (channel.constant)
+    {
+        o_rotation = channel.constantRotation;
+        o_translation = channel.constantPosition;
+        return;
+    }
+
+    if (IsCompressed())
+    {
+        unsigned int frame = 0;
+        float factor = 0.0f;
+        FindFrame(i_animationTime, frame, factor);
+        CalcCompressedRotation(o_rotation, i_channel, frame, factor);
+        CalcCompressedPosition(o_translation, i_channel, frame, factor);
+        return;
+    }
+
+    if (IsResampled())
+    {
+        unsigned int frame = 0;
+        float factor = 0.0f;
+        FindFrame(i_animationTime, frame, factor);
+        CalcResampledRotation(o_rotation, i_channel, frame, factor);
+        CalcResampledPosition(o_translation, i_channel, frame, factor);
+        return;
+    }
+
+    sampleKeys(channel, i_animationTime, io_cursor, o_rotation, o_translation);
+}
+
+//----------------------------------------------------------------
+
+void AnimationClip::SamplePose(float i_animationTime, std::vector<KeyCursor>& io_cursors,
+                               Pose& io_pose) const
+{
+    for (unsigned int i = 0; i < m_nodeChannels.size(); ++i)
+    {
+        io_pose.animated[i] = m_nodeChannels[i] != NO_CHANNEL;
+    }
+
+    if (IsCompressed())
+    {
+        sampleCompressedPose(i_animationTime, io_pose);
+        return;
+    }
+
+    for (unsigned int c = 0; c < m_channels.size(); ++c)
+    {
+        const unsigned int node = m_channels[c].node;
+        SampleChannel(c, i_animationTime, io_cursors[c], io_pose.rotations[node],
+                      io_pose.translations[node]);
+    }
+}
+
+//----------------------------------------------------------------
+
+void AnimationClip::MakeAdditive(const Pose& i_reference)
+{
+    assert(!IsResampled());
+
+    for (AnimationChannel& channel : m_channels)
+    {
+        const glm::quat inverseRotation = glm::inverse(i_reference.rotations[channel.node]);
+        const glm::vec3& referenceTranslation = i_reference.translations[channel.node];
+
+        for (glm::quat& rotation : channel.rotations)
+        {
+            rotation = glm::normalize(inverseRotation * rotation);
+        }
+
+        for (glm::vec3& position : channel.positions)
+        {
+            position -= referenceTranslation;
+        }
+
+        channel.constantRotation = glm::normalize(inverseRotation * channel.constantRotation);
+        channel.constantPosition -= referenceTranslation;
+    }
+
+    m_name += "_additive";
+    m_additive = true;
+}
+
+//----------------------------------------------------------------
+
+ClipReport AnimationClip::Resample(float i_sampleRate)
+{
+    assert(i_sampleRate > 0.0f);
+
+    ClipReport report;
+    if (IsCompressed())
+    {
+        // the float keys the streams are sampled from were released by Compress
+        std::cout << "[AnimationClip] " << m_name << " is compressed and cannot be resampled"
+                  << std::endl;
+        return report;
+    }
+
+    const unsigned int numChannels = static_cast<unsigned int>(m_channels.size());
+
+    // frame f is sampled at f / m_framesPerTick, the last frame closes the final interval
+    m_framesPerTick = i_sampleRate / m_ticksPerSecond;
+    m_numFrames = static_cast<unsigned int>(std::floor(m_endTime * m_framesPerTick)) + 2;
+
+    m_rotationStream.resize(m_numFrames * numChannels);
+    m_positionStream.resize(m_numFrames * numChannels);
+
+    std::vector<KeyCursor> cursors(numChannels);
+    for (unsigned int f = 0; f < m_numFrames; ++f)
+    {
+        const float time = f / m_framesPerTick;
+        for (unsigned int c = 0; c < numChannels; ++c)
+        {
+            const unsigned int sample = f * numChannels + c;
+            glm::quat rotation;
+            sampleKeys(m_channels[c], time, cursors[c], rotation, m_positionStream[sample]);
+
+            // keep neighbouring samples in the same hemisphere, so playback can blend them
+            // without a sign test
+            if (f > 0 && glm::dot(m_rotationStream[sample - numChannels], rotation) < 0.0f)
+            {
+                rotation = -rotation;
+            }
+            m_rotationStream[sample] = rotation;
+        }
+    }
+
+    report.sampleRate = i_sampleRate;
+    report.numFrames = m_numFrames;
+    report.clipBytes = m_numFrames * numChannels * (sizeof(glm::quat) + sizeof(glm::vec3));
+    measureError(report);
+
+    std::cout << "[AnimationClip] " << m_name << " resampled at " << i_sampleRate << " Hz ("
+              << m_numFrames << " frames), max rotation error "
+              << glm::degrees(report.maxRotationError) << " deg, max position error "
+              << report.maxPositionError << std::endl;
+
+    return report;
+}
+
+//----------------------------------------------------------------
+
+ClipReport AnimationClip::Compress(float i_sampleRate)
+{
+    if (IsCompressed())
+    {
+        // the float streams the quantized ones were packed from are gone
+        std::cout << "[AnimationClip] " << m_name << " is already compressed" << std::endl;
+        return ClipReport();
+    }
+
+    if (!IsResampled())
+    {
+        Resample(i_sampleRate);
+    }
+
+    const unsigned int numChannels = static_cast<unsigned int>(m_channels.size());
+    const size_t numSamples = m_rotationStream.size();
+
+    m_positionRanges.resize(numChannels);
+    for (unsigned int c = 0; c < numChannels; ++c)
+    {
+        m_positionRanges[c] = MakeRange(m_positionStream, c, numChannels);
+    }
+
+    m_packedRotations.resize(numSamples * 3);
+    m_packedPositions.resize(numSamples);
+    for (size_t i = 0; i < numSamples; ++i)
+    {
+        const unsigned int c = static_cast<unsigned int>(i % numChannels);
+        const PackedQuat rotation = PackQuat(m_rotationStream[i]);
+        const size_t plane = (i - c) * 3 + c;
+        m_packedRotations[plane] = rotation.data[0];
+        m_packedRotations[plane + numChannels] = rotation.data[1];
+        m_packedRotations[plane + 2 * numChannels] = rotation.data[2];
+        m_packedPositions[i] = PackVec3(m_positionStream[i], m_positionRanges[c]);
+    }
+
+    ClipReport report;
+    report.sampleRate = m_framesPerTick * m_ticksPerSecond;
+    report.numFrames = m_numFrames;
+    report.clipBytes = numSamples * (sizeof(PackedQuat) + sizeof(PackedVec3)) +
+                       numChannels * sizeof(QuantizationRange);
+    measureError(report);
+
+    // the quantized streams replace the keys and the float streams
+    std::vector<glm::quat>().swap(m_rotationStream);
+    std::vector<glm::vec3>().swap(m_positionStream);
+    for (AnimationChannel& channel : m_channels)
+    {
+        std::vector<float>().swap(channel.positionTimes);
+        std::vector<glm::vec3>().swap(channel.positions);
+        std::vector<float>().swap(channel.rotationTimes);
+        std::vector<glm::quat>().swap(channel.rotations);
+        std::vector<float>().swap(channel.scalingTimes);
+        std::vector<glm::vec3>().swap(channel.scalings);
+    }
+
+    std::cout << "[AnimationClip] " << m_name << " compressed " << report.sourceBytes << " -> "
+              << report.clipBytes << " bytes, max rotation error "
+              << glm::degrees(report.maxRotationError) << " deg, max position error "
+              << report.maxPositionError << std::endl;
+
+    return report;
+}
+
+//----------------------------------------------------------------
+
+void AnimationClip::measureError(ClipReport& io_report) const
+{
+    const unsigned int numChannels = static_cast<unsigned int>(m_channels.size());
+    io_report.rotationErrors.assign(numChannels, 0.0f);
+    io_report.positionErrors.assign(numChannels, 0.0f);
+    io_report.maxRotationError = 0.0f;
+    io_report.maxPositionError = 0.0f;
+    io_report.sourceBytes = 0;
+
+    KeyCursor cursor;
+    glm::quat rotation;
+    glm::vec3 position;
+
+    for (unsigned int c = 0; c < numChannels; ++c)
+    {
+        const AnimationChannel& channel = m_channels[c];
+        io_report.sourceBytes += channel.rotations.size() * sizeof(aiQuatKey) +
+                                 channel.positions.size() * sizeof(aiVectorKey) +
+                                 channel.scalings.size() * sizeof(aiVectorKey);
+
+        for (unsigned int k = 0; k < channel.rotations.size(); ++k)
+        {
+            SampleChannel(c, channel.rotationTimes[k], cursor, rotation, position);
+            float cosHalfAngle = std::min(std::abs(glm::dot(rotation, channel.rotations[k])), 1.0f);
+            io_report.rotationErrors[c] =
+                std::max(io_report.rotationErrors[c], 2.0f * std::acos(cosHalfAngle));
+        }
+
+        for (unsigned int k = 0; k < channel.positions.size(); ++k)
+        {
+            SampleChannel(c, channel.positionTimes[k], cursor, rotation, position);
+            io_report.positionErrors[c] = std::max(io_report.positionErrors[c],
+                                                   glm::length(position - channel.positions[k]));
+        }
+
+        io_report.maxRotationError =
+            std::max(io_report.maxRotationError, io_report.rotationErrors[c]);
+        io_report.maxPositionError =
+            std::max(io_report.maxPositionError, io_report.positionErrors[c]);
+    }
+}
+
+//----------------------------------------------------------------
+
+void AnimationClip::sampleKeys(const AnimationChannel& i_channel, float i_animationTime,
+                               KeyCursor& io_cursor, glm::quat& o_rotation,
+                               glm::vec3& o_translation) const
+{
+    if (i_animationTime <= i_channel.rotationTimes.front())
+    {
+        o_rotation = i_channel.rotations.front();
+    }
+    else if (i_animationTime >= i_channel.rotationTimes.back())
+    {
+        o_rotation = i_channel.rotations.back();
+    }
+    else
+    {
+        CalcInterpolatedRotaion(o_rotation, i_animationTime, i_channel, io_cursor);
+    }
+
+    if (i_animationTime <= i_channel.positionTimes.front())
+    {
+        o_translation = i_channel.positions.front();
+    }
+    else if (i_animationTime >= i_channel.positionTimes.back())
+    {
+        o_translation = i_channel.positions.back();
+    }
+    else
+    {
+        CalcInterpolatedPosition(o_translation, i_animationTime, i_channel, io_cursor);
+    }
+}
+
+//----------------------------------------------------------------
+
+void AnimationClip::FindFrame(float AnimationTime, unsigned int& o_frame, float& o_factor) const
+{
+    const float position = std::max(AnimationTime, 0.0f) * m_framesPerTick;
+    o_frame = std::min(static_cast<unsigned int>(position), m_numFrames - 2);
+    o_factor = std::min(position - (float)o_frame, 1.0f);
+}
+
+//----------------------------------------------------------------
+
+void AnimationClip::CalcResampledRotation(glm::quat& Out, unsigned int i_channel,
+                                          unsigned int i_frame, float i_factor) const
+{
+    const size_t stride = m_channels.size();
+    const size_t first = i_frame * stride + i_channel;
+    const glm::quat& Start = m_rotationStream[first];
+    const glm::quat& End = m_rotationStream[first + stride];
+    Out = glm::normalize(Start * (1.0f - i_factor) + End * i_factor);
+}
+
+//----------------------------------------------------------------
+
+void AnimationClip::CalcResampledPosition(glm::vec3& Out, unsigned int i_channel,
+                                          unsigned int i_frame, float i_factor) const
+{
+    const size_t stride = m_channels.size();
+    const size_t first = i_frame * stride + i_channel;
+    const glm::vec3& Start = m_positionStream[first];
+    const glm::vec3& End = m_positionStream[first + stride];
+    Out = Start + i_factor * (End - Start);
+}
+
+//----------------------------------------------------------------
+
+void AnimationClip::CalcInterpolatedScaling(glm::vec3& Out, float AnimationTime,
+                                            const AnimationChannel& i_channel,
+                                            KeyCursor& io_cursor) const
+{
+    if (i_channel.scalings.size() == 1)
+    {
+        Out = i_channel.scalings[0];
+        return;
+    }
+
+    unsigned int ScalingIndex = FindScaling(AnimationTime, i_channel, io_cursor);
+    unsigned int NextScalingIndex = (ScalingIndex + 1);
+    assert(NextScalingIndex < i_channel.scalings.size());
+    float DeltaTime =
+        i_channel.scalingTimes[NextScalingIndex] - i_channel.scalingTimes[ScalingIndex];
+    float Factor = (AnimationTime - i_channel.scalingTimes[ScalingIndex]) / DeltaTime;
+    assert(Factor >= 0.0f && Factor <= 1.0f);
+    const glm::vec3& Start = i_channel.scalings[ScalingIndex];
+    const glm::vec3& End = i_channel.scalings[NextScalingIndex];
+    Out = Start + Factor * (End - Start);
+}
+
+//----------------------------------------------------------------
+
+void AnimationClip::CalcInterpolatedRotaion(glm::quat& Out, float AnimationTime,
+                                            const AnimationChannel& i_channel,
+                                            KeyCursor& io_cursor) const
+{
+    // we need at least two values to interpolate...
+    if (i_channel.rotations.size() == 1)
+    {
+        Out = i_channel.rotations[0];
+        return;
+    }
+
+    unsigned int RotationIndex = FindRotation(AnimationTime, i_channel, io_cursor);
+    unsigned int NextRotationIndex = (RotationIndex + 1);
+    assert(NextRotationIndex < i_channel.rotations.size());
+    float DeltaTime =
+        i_channel.rotationTimes[NextRotationIndex] - i_channel.rotationTimes[RotationIndex];
+    float Factor = (AnimationTime - i_channel.rotationTimes[RotationIndex]) / DeltaTime;
+    assert(Factor >= 0.0f && Factor <= 1.0f);
+    const glm::quat& StartRotationQ = i_channel.rotations[RotationIndex];
+    const glm::quat& EndRotationQ = i_channel.rotations[NextRotationIndex];
+    // shortest path slerp, falls back to lerp for nearly identical keys like aiQuaternion
+    Out = glm::normalize(glm::slerp(StartRotationQ, EndRotationQ, Factor));
+}
+
+//----------------------------------------------------------------
+
+void AnimationClip::CalcInterpolatedPosition(glm::vec3& Out, float AnimationTime,
+                                             const AnimationChannel& i_channel,
+                                             KeyCursor& io_cursor) const
+{
+    if (i_channel.positions.size() == 1)
+    {
+        Out = i_channel.positions[0];
+        return;
+    }
+
+    unsigned int PositionIndex = FindPosition(AnimationTime, i_channel, io_cursor);
+    unsigned int NextPositionIndex = (PositionIndex + 1);
+    assert(NextPositionIndex < i_channel.positions.size());
+    float DeltaTime =
+        i_channel.positionTimes[NextPositionIndex] - i_channel.positionTimes[PositionIndex];
+    float Factor = (AnimationTime - i_channel.positionTimes[PositionIndex]) / DeltaTime;
+    assert(Factor >= 0.0f && Factor <= 1.0f);
+    const glm::vec3& Start = i_channel.positions[PositionIndex];
+    const glm::vec3& End = i_channel.positions[NextPositionIndex];
+    Out = Start + Factor * (End - Start);
+}
+
+//----------------------------------------------------------------
+
+unsigned int AnimationClip::FindScaling(float AnimationTime, const AnimationChannel& i_channel,
+                                        KeyCursor& io_cursor) const
+{
+    return FindKey(AnimationTime, i_channel.scalingTimes, io_cursor.scaling);
+}
+
+//----------------------------------------------------------------
+
+unsigned int AnimationClip::FindRotation(float AnimationTime, const AnimationChannel& i_channel,
+                                         KeyCursor& io_cursor) const
+{
+    return FindKey(AnimationTime, i_channel.rotationTimes, io_cursor.rotation);
+}
+
+//----------------------------------------------------------------
+
+unsigned int AnimationClip::FindPosition(float AnimationTime, const AnimationChannel& i_channel,
+                                         KeyCursor& io_cursor) const
+{
+    return FindKey(AnimationTime, i_channel.positionTimes, io_cursor.position);
+}
+
+//----------------------------------------------------------------
+
+void AnimationClip::sampleCompressedPose(float i_animationTime, Pose& io_pose) const
+{
+    unsigned int frame = 0;
+    float factor = 0.0f;
+    FindFrame(i_animationTime, frame, factor);
+
+    // the planes of a frame are contiguous, so both frames are decoded a block at a time
+    const unsigned int numChannels = static_cast<unsigned int>(m_channels.size());
+    float startX[UNPACK_BLOCK_SIZE], startY[UNPACK_BLOCK_SIZE], startZ[UNPACK_BLOCK_SIZE],
+        startW[UNPACK_BLOCK_SIZE];
+    float endX[UNPACK_BLOCK_SIZE], endY[UNPACK_BLOCK_SIZE], endZ[UNPACK_BLOCK_SIZE],
+        endW[UNPACK_BLOCK_SIZE];
+    for (unsigned int first = 0; first < numChannels; first += UNPACK_BLOCK_SIZE)
+    {
+        const unsigned int count = std::min(UNPACK_BLOCK_SIZE, numChannels - first);
+        const uint16_t* planes = &m_packedRotations[frame * 3 * numChannels + first];
+        UnpackQuats(planes, numChannels, count, startX, startY, startZ, startW);
+        UnpackQuats(planes + 3 * numChannels, numChannels, count, endX, endY, endZ, endW);
+
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            const unsigned int c = first + i;
+            const AnimationChannel& channel = m_channels[c];
+            if (channel.constant)
+            {
+                io_pose.rotations[channel.node] = channel.constantRotation;
+                io_pose.translations[channel.node] = channel.constantPosition;
+                continue;
+            }
+
+            // packing flips signs, so the hemisphere has to be checked again
+            const glm::quat start(startW[i], startX[i], startY[i], startZ[i]);
+            glm::quat end(endW[i], endX[i], endY[i], endZ[i]);
+            if (glm::dot(start, end) < 0.0f)
+            {
+                end = -end;
+            }
+            io_pose.rotations[channel.node] =
+                glm::normalize(start * (1.0f - factor) + end * factor);
+            CalcCompressedPosition(io_pose.translations[channel.node], c, frame, factor);
+        }
+    }
+}
+
+//----------------------------------------------------------------
+
+void AnimationClip::CalcCompressedRotation(glm::quat& Out, unsigned int i_channel,
+                                           unsigned int i_frame, float i_factor) const
+{
+    const size_t stride = m_channels.size();
+    const size_t first = i_frame * 3 * stride + i_channel;
+    glm::quat Start = UnpackQuat(&m_packedRotations[first], stride);
+    glm::quat End = UnpackQuat(&m_packedRotations[first + 3 * stride], stride);
+    // packing flips signs, so the hemisphere has to be checked again
+    if (glm::dot(Start, End) < 0.0f)
+    {
+        End = -End;
+    }
+    Out = glm::normalize(Start * (1.0f - i_factor) + End * i_factor);
+}
+
+//----------------------------------------------------------------
+
+void AnimationClip::CalcCompressedPosition(glm::vec3& Out, unsigned int i_channel,
+                                           unsigned int i_frame, float i_factor) const
+{
+    const size_t stride = m_channels.size();
+    const size_t first = i_frame * stride + i_channel;
+    const QuantizationRange& range = m_positionRanges[i_channel];
+    const glm::vec3 Start = UnpackVec3(m_packedPositions[first], range);
+    const glm::vec3 End = UnpackVec3(m_packedPositions[first + stride], range);
+    Out = Start + i_factor * (End - Start);
+}
@@ -0,0 +1,262 @@
+#pragma once
+
+#include "Rig.h"
+
+#include <glm.hpp>
+#include <gtc/quaternion.hpp>
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <assimp/scene.h>
+
+typedef std::map<std::string, const aiNodeAnim*> nodeAnimationMap;
+typedef std::map<std::string, nodeAnimationMap> AnimationMap;
+
+//------------------------------------------------------
+// ANIMATION CHANNEL
+//------------------------------------------------------
+
+// Keys of a single animated node, copied out of the aiNodeAnim
+struct AnimationChannel
+{
+    // rig node driven by this channel
+    unsigned int node = 0;
+
+    std::vector<float> positionTimes;
+    std::vector<glm::vec3> positions;
+    std::vector<float> rotationTimes;
+    std::vector<glm::quat> rotations;
+    std::vector<float> scalingTimes;
+    std::vector<glm::vec3> scalings;
+
+    // set when every rotation and position key holds the same value, sampling then returns
+    // the folded value without looking at the keys or streams
+    bool constant = false;
+    glm::quat constantRotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    glm::vec3 constantPosition = glm::vec3(0.0f);
+};
+
+//------------------------------------------------------
+// KEY CURSOR
+//------------------------------------------------------
+
+// Key indices used by the previous sample of a channel. Owned by the playing model, so a shared
+// clip can resume its key search where each instance stopped last frame.
+struct KeyCursor
+{
+    unsigned int position = 0;
+    unsigned int rotation = 0;
+    unsigned int scaling = 0;
+};
+
+//------------------------------------------------------
+// PACKED SAMPLES
+//------------------------------------------------------
+
+// Rotation in 48 bits: the three smallest components at 15 bits each, the index of the dropped
+// (largest) component is stored in the top bits of data[0] and data[1]
+struct PackedQuat
+{
+    uint16_t data[3];
+};
+
+// Vector in 48 bits, unorm16 per component relative to the channel range
+struct PackedVec3
+{
+    uint16_t data[3];
+};
+
+// Dequantization of a PackedVec3: value = min + data * scale
+struct QuantizationRange
+{
+    glm::vec3 min = glm::vec3(0.0f);
+    glm::vec3 scale = glm::vec3(0.0f);
+};
+
+//------------------------------------------------------
+// CLIP REPORT
+//------------------------------------------------------
+
+// Error of a resampled or compressed clip measured at the source keys
+struct ClipReport
+{
+    float sampleRate = 0.0f;
+    unsigned int numFrames = 0;
+    // size of the source keys as stored by Assimp and of the clip streams, in bytes
+    size_t sourceBytes = 0;
+    size_t clipBytes = 0;
+    // largest rotation error in radians and translation error in model units
+    float maxRotationError = 0.0f;
+    float maxPositionError = 0.0f;
+    // per channel errors, indexed like the clip channels
+    std::vector<float> rotationErrors;
+    std::vector<float> positionErrors;
+};
+
+//------------------------------------------------------
+// ANIMATION CLIP CLASS
+//------------------------------------------------------
+
+// Animation compiled against a rig. Every rig node owns one slot in a dense channel table, so
+// sampling a node is pure array indexing. A clip holds no pointers into the aiScene and can be
+// shared by every model using the same rig.
+class AnimationClip
+{
+  public:
+    static constexpr unsigned int NO_CHANNEL = 0xFFFFFFFF;
+
+    // Ctor
+    AnimationClip(const aiAnimation* i_animation, const nodeAnimationMap& i_channels,
+                  const Rig& i_rig);
+
+    const std::string& GetName() const
+    {
+        return m_name;
+    }
+
+    float GetTicksPerSecond() const
+    {
+        return m_ticksPerSecond;
+    }
+
+    // length of the clip in ticks, playback loops over [0, duration)
+    float GetDuration() const
+    {
+        return m_duration;
+    }
+
+    // returns the channel driving the given rig node or NO_CHANNEL
+    unsigned int GetNodeChannel(unsigned int i_node) const
+    {
+        return m_nodeChannels[i_node];
+    }
+
+    unsigned int GetNumChannels() const
+    {
+        return static_cast<unsigned int>(m_channels.size());
+    }
+
+    const AnimationChannel& GetChannel(unsigned int i_channel) const
+    {
+        return m_channels[i_channel];
+    }
+
+    unsigned int GetNumConstantChannels() const
+    {
+        return m_numConstantChannels;
+    }
+
+    // interpolate the local rotation and translation of a channel at the given time in ticks
+    void SampleChannel(unsigned int i_channel, float i_animationTime, KeyCursor& io_cursor,
+                       glm::quat& o_rotation, glm::vec3& o_translation) const;
+
+    // sample every channel into the pose, io_cursors holds one cursor per channel. Nodes the
+    // clip does not animate are flagged as such in the pose.
+    void SamplePose(float i_animationTime, std::vector<KeyCursor>& io_cursors,
+                    Pose& io_pose) const;
+
+    // turn the keys into local deltas from the reference pose, so the clip can be layered
+    // additively on top of another one. Has to run before the clip is resampled.
+    void MakeAdditive(const Pose& i_reference);
+
+    bool IsAdditive() const
+    {
+        return m_additive;
+    }
+
+    // resample every channel at a fixed rate (samples per second). Sampling then addresses the
+    // two surrounding frames directly instead of searching the keys. A compressed clip has no
+    // keys left to resample, it is kept as is and the report is empty.
+    ClipReport Resample(float i_sampleRate);
+
+    // quantize the resampled streams (resampling at i_sampleRate first if needed) and release
+    // the float keys and streams. Rotations are stored as 48 bit smallest three quaternions,
+    // translations as unorm16 relative to a per channel range. Scaling is not sampled, so it is
+    // not stored. Compressing twice keeps the clip as is and returns an empty report.
+    ClipReport Compress(float i_sampleRate);
+
+    bool IsResampled() const
+    {
+        return m_numFrames > 0;
+    }
+
+    bool IsCompressed() const
+    {
+        return !m_packedRotations.empty();
+    }
+
+  private:
+    // evaluate the source keys, holding the first/last key outside of their range
+    void sampleKeys(const AnimationChannel& i_channel, float i_animationTime, KeyCursor& io_cursor,
+                    glm::quat& o_rotation, glm::vec3& o_translation) const;
+
+    // frame index and blend factor of the resampled streams at the given time
+    void FindFrame(float AnimationTime, unsigned int& o_frame, float& o_factor) const;
+
+    void CalcResampledRotation(glm::quat& Out, unsigned int i_channel, unsigned int i_frame,
+                               float i_factor) const;
+
+    void CalcResampledPosition(glm::vec3& Out, unsigned int i_channel, unsigned int i_frame,
+                               float i_factor) const;
+
+    // SamplePose of a compressed clip, decodes the rotations of both frames a block of channels
+    // at a time with UnpackQuats
+    void sampleCompressedPose(float i_animationTime, Pose& io_pose) const;
+
+    void CalcCompressedRotation(glm::quat& Out, unsigned int i_channel, unsigned int i_frame,
+                                float i_factor) const;
+
+    void CalcCompressedPosition(glm::vec3& Out, unsigned int i_channel, unsigned int i_frame,
+                                float i_factor) const;
+
+    // fill the error fields of the report by sampling the clip at every source key
+    void measureError(ClipReport& io_report) const;
+
+    void CalcInterpolatedScaling(glm::vec3& Out, float AnimationTime,
+                                 const AnimationChannel& i_channel, KeyCursor& io_cursor) const;
+
+    void CalcInterpolatedRotaion(glm::quat& Out, float AnimationTime,
+                                 const AnimationChannel& i_channel, KeyCursor& io_cursor) const;
+
+    void CalcInterpolatedPosition(glm::vec3& Out, float AnimationTime,
+                                  const AnimationChannel& i_channel, KeyCursor& io_cursor) const;
+
+    unsigned int FindScaling(float AnimationTime, const AnimationChannel& i_channel,
+                             KeyCursor& io_cursor) const;
+
+    unsigned int FindRotation(float AnimationTime, const AnimationChannel& i_channel,
+                              KeyCursor& io_cursor) const;
+
+    unsigned int FindPosition(float AnimationTime, const AnimationChannel& i_channel,
+                              KeyCursor& io_cursor) const;
+
+    std::string m_name;
+    bool m_additive = false;
+    float m_ticksPerSecond = 25.0f;
+    float m_duration = 0.0f;
+    // time of the last key over all channels
+    float m_endTime = 0.0f;
+
+    // one slot per rig node, NO_CHANNEL for nodes the clip does not animate
+    std::vector<unsigned int> m_nodeChannels;
+    std::vector<AnimationChannel> m_channels;
+    unsigned int m_numConstantChannels = 0;
+
+    // Uniformly resampled streams, frame major: all channels of frame f are stored contiguously
+    // starting at f * m_channels.size(). Empty unless the clip was resampled.
+    unsigned int m_numFrames = 0;
+    float m_framesPerTick = 0.0f;
+    std::vector<glm::quat> m_rotationStream;
+    std::vector<glm::vec3> m_positionStream;
+
+    // Quantized streams, same frame major layout. Empty unless the clip was compressed. The
+    // rotations of a frame are split into three planes, data[k] of channel c in frame f is at
+    // (3 * f + k) * m_channels.size() + c.
+    std::vector<uint16_t> m_packedRotations;
+    std::vector<PackedVec3> m_packedPositions;
+    // one range per channel
+    std::vector<QuantizationRange> m_positionRanges;
+};
@@ -1,11 +1,16 @@
 ﻿#include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
+#include "BonePalette.h"
 #include "Camera.h"
+#include "ComputeSkinner.h"
+#include "CpuSkinner.h"
+#include "GpuResource.h"
 #include "Lamp.h"
 #include "Model.h"
 #include "Shader.h"
 #include "Skeleton.h"
+#include "SkinningSIMD.h"
 #include <glm.hpp>
 #include <gtc/matrix_transform.hpp>
 #include <gtc/type_ptr.hpp>
@@ -17,8 +22,13 @@
 #include "imgui/imgui_impl_glfw.h"
 #include "imgui/imgui_impl_opengl3.h"
 
+#include <cstring>
 #include <iostream>
+#include <memory>
 
+// everything drawn with the context, returns once the window is closed. Its GL objects are
+// deleted on return, while the context is still alive.
+void runScene(GLFWwindow* window);
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void processInput(GLFWwindow* window);
 void wireframeMode(GLFWwindow* window);
@@ -39,14 +49,21 @@ bool toggleObject = true;
 
 std::vector<glm::mat4> Transforms;
 std::vector<glm::highp_fdualquat> dualQuaternions;
-std::vector<glm::mat2x4> DQs;
 
 float deltaTime = 0.0f; // Time between current frame and last frame
 float lastFrame = 0.0f; // Time of last frame
 float animationTime = 0.0f;
 
-int main(void)
+// --check-kernels: self-test the CPU skinning kernels on the loaded model before the first frame
+bool checkKernels = false;
+
+int main(int argc, char** argv)
 {
+    for (int i = 1; i < argc; ++i)
+    {
+        checkKernels = checkKernels || strcmp(argv[i], "--check-kernels") == 0;
+    }
+
     GLFWwindow* window;
     /* Initialize the library */
     if (!glfwInit())
@@ -85,19 +102,96 @@ int main(void)
 
     std::cout << glGetString(GL_VERSION) << std::endl;
 
+    runScene(window);
+
+    // the scene owned every GL object and is gone, anything still alive leaked
+    GpuResource::ReportLeaks();
+
+    glfwTerminate();
+    return 0;
+}
+
+void runScene(GLFWwindow* window)
+{
     // configure global opengl state
     // -----------------------------
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_PROGRAM_POINT_SIZE);
 
     // Shader modelShader("res/shaders/vertex.shader", "res/shaders/fragment.shader");
-    Shader* lampShader = new Shader("res/shaders/lamp.vs", "res/shaders/lamp.fs");
+    Shader lampShader("res/shaders/lamp.vs", "res/shaders/lamp.fs");
     Shader skeletonShader("res/shaders/skeleton.vs", "res/shaders/skeleton.fs");
-    Shader modelShader("res/shaders/vertex.shader", "res/shaders/fragment.shader");
+    // one variant per SkinningMode, each compiles only the math of its method
+    const ShaderDefines lbsDefines{{GetSkinningDefine(SkinningMode::LBS)}};
+    const ShaderDefines dqsDefines{{GetSkinningDefine(SkinningMode::DQS)}};
+    const ShaderDefines hybridDefines{{GetSkinningDefine(SkinningMode::Hybrid)}};
+    Shader modelShaders[] = {
+        Shader("res/shaders/vertex.shader", "res/shaders/fragment.shader", lbsDefines),
+        Shader("res/shaders/vertex.shader", "res/shaders/fragment.shader", dqsDefines),
+        Shader("res/shaders/vertex.shader", "res/shaders/fragment.shader", hybridDefines)};
+    // skin once per frame into transform feedback buffers, then draw them with a pass-through
+    const std::vector<std::string> feedbackVaryings = {"FragPos", "Normal", "TexCoord"};
+    Shader skinShaders[] = {
+        Shader("res/shaders/vertex.shader", feedbackVaryings, lbsDefines),
+        Shader("res/shaders/vertex.shader", feedbackVaryings, dqsDefines),
+        Shader("res/shaders/vertex.shader", feedbackVaryings, hybridDefines)};
+    Shader skinnedShader("res/shaders/skinned.vs", "res/shaders/fragment.shader");
+
+    for (unsigned int i = 0; i < ARRAY_SIZE_IN_ELEMENTS(modelShaders); ++i)
+    {
+        BonePalette::BindSampler(modelShaders[i]);
+        BonePalette::BindSampler(skinShaders[i]);
+    }
 
     // Load skinned model (FBX) from the resources directory.
     Model aModel("../res/asset/test/get_up.fbx");
 
+    // bone palettes of the vertex shader skinning, written in place into a ring of mapped frames
+    // of a texture buffer sized for the model's rig. A rig the texture buffer cannot hold is
+    // skinned on the CPU instead.
+    std::unique_ptr<BonePalette> bonePalette;
+    if (aModel.m_NumBones <= BonePalette::GetMaxBones())
+    {
+        bonePalette.reset(new BonePalette(aModel.m_NumBones));
+    }
+    else
+    {
+        std::cout << "[Application] " << aModel.m_NumBones << " bones exceed the "
+                  << BonePalette::GetMaxBones() << " of a bone palette, skinning on the CPU"
+                  << std::endl;
+    }
+
+    // compute skinning needs GL 4.3, otherwise vertex.shader skins while drawing
+    std::unique_ptr<ComputeSkinner> computeSkinner;
+    if (ComputeSkinner::IsSupported())
+    {
+        computeSkinner.reset(new ComputeSkinner(aModel));
+    }
+    else
+    {
+        std::cout << "[Application] No compute shaders, skinning in the vertex shader"
+                  << std::endl;
+    }
+
+    // skinning on the CPU workers, the result is uploaded and drawn like the feedback output
+    WorkerPool workerPool;
+    CpuSkinner cpuSkinner(aModel, workerPool);
+    // last sweep of the worker counts, shown in the CPU skinning panel
+    std::vector<WorkerScaling> workerScaling;
+
+    // self-test of the SIMD kernels on the loaded meshes, the hybrid palettes hold both
+    if (checkKernels)
+    {
+        aModel.BoneTransform(0.0f, Transforms, dualQuaternions);
+        if (!CheckSkinningKernels(aModel.GetMeshes(), Transforms, dualQuaternions, 0.5f))
+        {
+            std::cout << "[Application] SIMD skinning kernels disagree with the reference, "
+                         "CPU skinning falls back to the scalar kernel"
+                      << std::endl;
+            cpuSkinner.SetSimdLevel(SimdLevel::Scalar);
+        }
+    }
+
     //===========================================================
     // LAMP
     //===========================================================
@@ -106,6 +200,9 @@ int main(void)
 
     Lamp lamp(lampPos, lampColor);
 
+    // joint positions are uploaded into the same buffers every frame
+    Skeleton skeleton(aModel.skeleton_pose);
+
     ImGui::CreateContext();
     ImGui_ImplGlfw_InitForOpenGL(window, true);
     // Match ImGui's shaders to a GLSL version supported by our context.
@@ -117,6 +214,12 @@ int main(void)
     bool lbs = false;
     bool dqs = false;
     static float f = 0.0f;
+    bool skinOnce = false;
+    bool computeSkinning = computeSkinner != nullptr;
+    // without bone palettes the CPU skins, whatever the checkbox says
+    bool cpuSkinning = bonePalette == nullptr;
+    int currentClip = 0;
+    float fadeDuration = 0.5f;
 
     bool show_demo_window = false;
     ImVec4 clear_color = ImVec4(0.098f, 0.231f, 0.298f, 1.00f);
@@ -152,61 +255,102 @@ int main(void)
 
         // activate model shader
         //  render 3D model
-        modelShader.use(); // 3d model shader
+        // with CPU, compute or skin once skinning the vertices are skinned before the passes,
+        // which draw them through the pass-through shader
+        const bool useCpu = cpuSkinning || !bonePalette;
+        const bool useCompute = !useCpu && computeSkinning && computeSkinner;
+        const bool preSkinned = useCpu || useCompute || skinOnce;
+        // Skinning + model rendering, with the variant of the selected method
+        const SkinningMode skinningMode = GetSkinningVariant(GetSkinningMode(lbs, dqs), f);
+        const int variant = static_cast<int>(skinningMode);
+        Shader& skinningShader = skinOnce ? skinShaders[variant] : modelShaders[variant];
+        Shader& drawShader = preSkinned ? skinnedShader : modelShaders[variant];
+
+        if (useCpu)
+        {
+            aModel.BoneTransform(animationTime, skinningMode, Transforms, dualQuaternions);
+            cpuSkinner.Skin(Transforms, dualQuaternions, skinningMode, f);
+            cpuSkinner.Upload(aModel);
+        }
+        else if (useCompute)
+        {
+            aModel.BoneTransform(animationTime, skinningMode, Transforms, dualQuaternions);
+            computeSkinner->SetPalette(0, Transforms, dualQuaternions, skinningMode);
+            computeSkinner->Dispatch(skinningMode, f);
+        }
+        else
+        {
+            // the pose goes straight into this frame's palettes, no staging copy
+            bonePalette->BeginFrame(skinningMode);
+            aModel.BoneTransform(animationTime, skinningMode, bonePalette->GetMatrices(0),
+                                 bonePalette->GetDualQuats(0));
+            bonePalette->EndWrites();
+
+            skinningShader.use();
+            bonePalette->Bind(0, skinningShader);
+
+            // only read by the hybrid variant
+            skinningShader.setFloat("ratio", f);
+
+            if (skinOnce)
+            {
+                // skinned vertices are captured in model space
+                skinningShader.setMat4("model", glm::mat4(1.0f));
+                aModel.SkinToFeedback();
+            }
+        }
+
+        drawShader.use(); // 3d model shader
         glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom),
                                                 (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        modelShader.setMat4("projection", projection);
+        drawShader.setMat4("projection", projection);
         glm::mat4 view = camera.GetViewMatrix();
-        modelShader.setMat4("view", view);
+        drawShader.setMat4("view", view);
         glm::mat4 model(1.0f);
         model = glm::scale(model,
                            glm::vec3(0.005f, 0.005f,
                                      0.005f)); // it's a bit too big for our scene, so scale it down
-        modelShader.setMat4("model", model);
-        // Skinning + model rendering
-        aModel.BoneTransform(animationTime, Transforms, dualQuaternions);
-        for (unsigned int i = 0; i < Transforms.size(); ++i)
+        drawShader.setMat4("model", model);
+
+        // set uniforms for model shader
+        drawShader.setVec3("lightPos", lamp.getPosition());
+        drawShader.setVec3("lightColor", lamp.getColor());
+        drawShader.setVec3("viewPos", camera.Position);
+        if (useCompute)
         {
-            const std::string name = "gBones[" + std::to_string(i) + "]";
-            GLuint boneTransform = glGetUniformLocation(modelShader.ID, name.c_str());
-            glUniformMatrix4fv(boneTransform, 1, GL_FALSE, glm::value_ptr(Transforms[i]));
+            computeSkinner->Draw(0, drawShader);
         }
-
-        DQs.resize(dualQuaternions.size());
-        for (unsigned int i = 0; i < dualQuaternions.size(); ++i)
+        else if (useCpu || skinOnce)
         {
-            DQs[i] = glm::mat2x4_cast(dualQuaternions[i]);
-            const std::string name = "dqs[" + std::to_string(i) + "]";
-            modelShader.setMat2x4(name, DQs[i]);
+            aModel.DrawSkinned(drawShader);
+        }
+        else
+        {
+            aModel.Draw(drawShader);
+        }
+        if (!useCpu && !useCompute)
+        {
+            // fenced behind its last draw, written again PALETTE_FRAMES frames later
+            bonePalette->EndFrame();
         }
-
-        // set uniforms for model shader
-        modelShader.setVec3("lightPos", lamp.getPosition());
-        modelShader.setVec3("lightColor", lamp.getColor());
-        modelShader.setVec3("viewPos", camera.Position);
-        // defult LBS
-        modelShader.setBool("lbsOn", lbs);
-        modelShader.setBool("dqsOn", dqs);
-        modelShader.setFloat("ratio", f);
-        aModel.Draw(modelShader);
 
         // activate lamp shader
         // render light cube(lamp)
         // lamp.Position.x = 1.0f + sin(glfwGetTime()) * 2.0f;
-        lampShader->use();
-        lampShader->setMat4("projection", projection);
-        lampShader->setMat4("view", view);
+        lampShader.use();
+        lampShader.setMat4("projection", projection);
+        lampShader.setMat4("view", view);
         glm::mat4 lamp_cube(1.0f);
         // lamp_cube = glm::rotate(lamp_cube, (float)glfwGetTime(), glm::vec3(0.0, 1.0, 0.0));
         lamp_cube = glm::translate(lamp_cube, lamp.getPosition());
         lamp_cube = glm::scale(
             lamp_cube, glm::vec3(0.2f)); // it's a bit too big for our scene, so scale it down
         // set uniforms for lamp shader
-        lampShader->setMat4("model", lamp_cube);
+        lampShader.setMat4("model", lamp_cube);
         lamp.Draw(lampShader);
 
         // activate skeleton shader (visualize skeleton of the skinned model)
-        Skeleton* skeleton = new Skeleton(aModel.skeleton_pose);
+        skeleton.Update(aModel.skeleton_pose);
 
         skeletonShader.use();
         skeletonShader.setMat4("projection", projection);
@@ -217,7 +361,7 @@ int main(void)
                        glm::vec3(0.005f, 0.005f,
                                  0.005f)); // it's a bit too big for our scene, so scale it down
         skeletonShader.setMat4("model", skeletom_model);
-        skeleton->Draw(skeletonShader);
+        skeleton.Draw(skeletonShader);
 
         if (show_demo_window)
             ImGui::ShowDemoWindow(&show_demo_window);
@@ -231,6 +375,55 @@ int main(void)
 
             ImGui::SliderFloat("Ratio on DQS", &f, 0.0f,
                                1.0f); // Edit 1 float using a slider from 0.0f to 1.0f
+
+            // skin into transform feedback buffers once, passes draw the captured vertices
+            ImGui::Checkbox("Skin once (transform feedback)", &skinOnce);
+
+            // all meshes in one dispatch, only offered when the context has compute shaders
+            if (computeSkinner)
+            {
+                ImGui::Checkbox("Compute skinning", &computeSkinning);
+            }
+
+            // skin in chunks on the worker pool, overrides the GPU paths
+            ImGui::Checkbox("CPU skinning", &cpuSkinning);
+            const std::vector<ChunkTiming>& chunks = cpuSkinner.GetChunkTimings();
+            if (cpuSkinning && !chunks.empty())
+            {
+                ImGui::Text("%u chunks on %u workers: %.1f us", (unsigned int)chunks.size(),
+                            cpuSkinner.GetNumWorkers(), cpuSkinner.GetSkinMicroseconds());
+                ImGui::PlotHistogram("Chunk us", &chunks[0].microseconds, (int)chunks.size(), 0,
+                                     NULL, 0.0f, FLT_MAX, ImVec2(0, 60), sizeof(ChunkTiming));
+                // averages 100 frames' worth of skinning with this frame's pose on 1 to N workers
+                if (ImGui::Button("Sweep worker counts"))
+                {
+                    workerScaling = CpuSkinner::SweepWorkers(aModel, 0, Transforms,
+                                                             dualQuaternions, skinningMode, f, 100);
+                }
+                for (const WorkerScaling& scaling : workerScaling)
+                {
+                    ImGui::Text("%2u workers: %8.1f us, speedup %.2f", scaling.numWorkers,
+                                scaling.microseconds, scaling.speedup);
+                }
+            }
+
+            // switching clips crossfades from the playing one
+            const auto& clips = aModel.GetClips();
+            if (clips.size() > 1)
+            {
+                ImGui::SliderFloat("Crossfade (s)", &fadeDuration, 0.0f, 2.0f);
+                for (int i = 0; i < (int)clips.size(); ++i)
+                {
+                    ImGui::PushID(i);
+                    if (ImGui::RadioButton(clips[i]->GetName().c_str(), currentClip == i) &&
+                        currentClip != i)
+                    {
+                        currentClip = i;
+                        aModel.CrossfadeTo(i, fadeDuration);
+                    }
+                    ImGui::PopID();
+                }
+            }
             ImGui::ColorEdit3("clear color",
                               (float*)&clear_color); // Edit 3 floats representing a color
 
@@ -252,9 +445,6 @@ int main(void)
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
-
-    glfwTerminate();
-    return 0;
 }
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
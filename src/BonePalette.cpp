@@ -0,0 +1,243 @@
+#include "BonePalette.h"
+#include "Model.h"
+
+#include <algorithm>
+#include <cassert>
+
+//----------------------------------------------------------------
+
+bool BonePalette::HasPersistentMapping()
+{
+    return (GLEW_ARB_buffer_storage || GLEW_VERSION_4_4) && glBufferStorage != nullptr;
+}
+
+//----------------------------------------------------------------
+
+unsigned int BonePalette::GetMaxBones(unsigned int i_numInstances)
+{
+    GLint maxTexels = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+    const unsigned int texelsPerBone = MATRIX_TEXELS + DUAL_QUAT_TEXELS;
+    return maxTexels / (PALETTE_FRAMES * i_numInstances * texelsPerBone);
+}
+
+//----------------------------------------------------------------
+
+BonePalette::BonePalette(unsigned int i_numBones, unsigned int i_numInstances)
+    : m_numBones(i_numBones), m_numInstances(i_numInstances),
+      m_persistent(HasPersistentMapping())
+{
+    assert(m_numInstances > 0);
+
+    const unsigned int maxBones = GetMaxBones(m_numInstances);
+    if (m_numBones > maxBones)
+    {
+        std::cout << "[BonePalette] " << m_numBones << " bones exceed the " << maxBones
+                  << " a texture buffer holds for " << m_numInstances << " instances"
+                  << std::endl;
+        assert(false);
+    }
+
+    // at least one texel, a palette without bones still needs a buffer to bind
+    const unsigned int instanceTexels = m_numBones * (MATRIX_TEXELS + DUAL_QUAT_TEXELS);
+    m_frameSize = m_numInstances * std::max(instanceTexels, 1u) * TEXEL_SIZE;
+    const unsigned int size = PALETTE_FRAMES * m_frameSize;
+
+    m_TBO = GpuResource(GpuResourceType::Buffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, m_TBO.Get());
+    if (m_persistent)
+    {
+        // coherent, so the writes are visible to the draws issued after them without a flush
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_TEXTURE_BUFFER, size, nullptr, flags);
+        m_mapped = static_cast<unsigned char*>(glMapBufferRange(GL_TEXTURE_BUFFER, 0, size, flags));
+    }
+    else
+    {
+        glBufferData(GL_TEXTURE_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    // one texture over the whole ring, draws pick their frame and instance by base texel
+    m_texture = GpuResource(GpuResourceType::Texture);
+    glBindTexture(GL_TEXTURE_BUFFER, m_texture.Get());
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_TBO.Get());
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+    std::cout << "[BonePalette] " << m_numBones << " bones, " << m_numInstances << " instances, "
+              << PALETTE_FRAMES << " frames of " << m_frameSize << " bytes, "
+              << (m_persistent ? "persistent mapping" : "unsynchronized mapping with orphaning")
+              << std::endl;
+}
+
+//----------------------------------------------------------------
+
+BonePalette::~BonePalette()
+{
+    for (GLsync fence : m_fences)
+    {
+        if (fence != nullptr)
+        {
+            glDeleteSync(fence);
+        }
+    }
+
+    if (m_mapped != nullptr || m_frameData != nullptr)
+    {
+        glBindBuffer(GL_TEXTURE_BUFFER, m_TBO.Get());
+        glUnmapBuffer(GL_TEXTURE_BUFFER);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+}
+
+//----------------------------------------------------------------
+
+void BonePalette::BindSampler(Shader& i_shader)
+{
+    i_shader.use();
+    i_shader.setInt("bonePalette", PALETTE_TEXTURE_UNIT);
+}
+
+//----------------------------------------------------------------
+
+void BonePalette::BeginFrame(SkinningMode i_mode)
+{
+    assert(m_frameData == nullptr);
+    const unsigned int offset = m_frame * m_frameSize;
+
+    m_mode = i_mode;
+    m_matricesTexels = i_mode != SkinningMode::DQS ? m_numBones * MATRIX_TEXELS : 0;
+    m_instanceTexels = m_matricesTexels;
+    if (i_mode != SkinningMode::LBS)
+    {
+        m_instanceTexels += m_numBones * DUAL_QUAT_TEXELS;
+    }
+
+    if (m_persistent)
+    {
+        // the draws of this frame PALETTE_FRAMES frames ago may still be reading it
+        GLsync& fence = m_fences[m_frame];
+        if (fence != nullptr)
+        {
+            GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+            while (status == GL_TIMEOUT_EXPIRED)
+            {
+                status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+            }
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+        m_frameData = m_mapped + offset;
+        return;
+    }
+
+    glBindBuffer(GL_TEXTURE_BUFFER, m_TBO.Get());
+    if (m_frame == 0)
+    {
+        // orphan on wrap, the frames still in flight keep the old storage
+        glBufferData(GL_TEXTURE_BUFFER, PALETTE_FRAMES * m_frameSize, nullptr, GL_STREAM_DRAW);
+    }
+    // nothing in flight reads this range of the current storage, so no synchronization
+    const GLbitfield access =
+        GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT;
+    // at least one texel, mapping an empty range is an error
+    const unsigned int size = std::max(m_numInstances * m_instanceTexels, 1u) * TEXEL_SIZE;
+    void* frame = glMapBufferRange(GL_TEXTURE_BUFFER, offset, size, access);
+    m_frameData = static_cast<unsigned char*>(frame);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+//----------------------------------------------------------------
+
+glm::mat3x4* BonePalette::GetMatrices(unsigned int i_instance)
+{
+    assert(m_frameData != nullptr && i_instance < m_numInstances);
+    if (m_mode == SkinningMode::DQS)
+    {
+        return nullptr;
+    }
+    const unsigned int offset = getMatricesTexel(i_instance) * TEXEL_SIZE;
+    return reinterpret_cast<glm::mat3x4*>(m_frameData + offset);
+}
+
+//----------------------------------------------------------------
+
+glm::mat2x4* BonePalette::GetDualQuats(unsigned int i_instance)
+{
+    assert(m_frameData != nullptr && i_instance < m_numInstances);
+    if (m_mode == SkinningMode::LBS)
+    {
+        return nullptr;
+    }
+    const unsigned int offset = getDualQuatsTexel(i_instance) * TEXEL_SIZE;
+    return reinterpret_cast<glm::mat2x4*>(m_frameData + offset);
+}
+
+//----------------------------------------------------------------
+
+void BonePalette::Write(unsigned int i_instance, const std::vector<glm::mat4>& i_transforms,
+                        const std::vector<glm::fdualquat>& i_dqs)
+{
+    if (m_mode != SkinningMode::DQS)
+    {
+        assert(i_transforms.size() <= m_numBones);
+        glm::mat3x4* matrices = GetMatrices(i_instance);
+        for (unsigned int i = 0; i < i_transforms.size(); ++i)
+        {
+            matrices[i] = convertMatrix(i_transforms[i]);
+        }
+    }
+
+    if (m_mode != SkinningMode::LBS)
+    {
+        assert(i_dqs.size() <= m_numBones);
+        glm::mat2x4* dualQuats = GetDualQuats(i_instance);
+        for (unsigned int i = 0; i < i_dqs.size(); ++i)
+        {
+            dualQuats[i] = glm::mat2x4_cast(i_dqs[i]);
+        }
+    }
+}
+
+//----------------------------------------------------------------
+
+void BonePalette::EndWrites()
+{
+    assert(m_frameData != nullptr);
+    if (!m_persistent)
+    {
+        // a buffer cannot be drawn from while it is mapped without GL_MAP_PERSISTENT_BIT
+        glBindBuffer(GL_TEXTURE_BUFFER, m_TBO.Get());
+        glUnmapBuffer(GL_TEXTURE_BUFFER);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+    m_frameData = nullptr;
+}
+
+//----------------------------------------------------------------
+
+void BonePalette::Bind(unsigned int i_instance, const Shader& i_shader) const
+{
+    assert(i_instance < m_numInstances);
+    const unsigned int frame = m_frame * m_frameSize / TEXEL_SIZE;
+
+    glActiveTexture(GL_TEXTURE0 + PALETTE_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, m_texture.Get());
+    glActiveTexture(GL_TEXTURE0);
+
+    // a variant without one of the palettes has no such uniform, the call is then ignored
+    i_shader.setInt("boneMatricesBase", frame + getMatricesTexel(i_instance));
+    i_shader.setInt("boneDualQuatsBase", frame + getDualQuatsTexel(i_instance));
+}
+
+//----------------------------------------------------------------
+
+void BonePalette::EndFrame()
+{
+    assert(m_frameData == nullptr);
+    if (m_persistent)
+    {
+        m_fences[m_frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    m_frame = (m_frame + 1) % PALETTE_FRAMES;
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "GpuResource.h"
+#include "MeshData.inl"
+#include "Shader.h"
+
+#include <glm.hpp>
+#define GLM_ENABLE_EXPERIMENTAL
+#include <gtx/dual_quaternion.hpp>
+
+#include <vector>
+
+// Frames in flight in the palette ring, the CPU writes one while the GPU may still read two
+#define PALETTE_FRAMES 3
+// Texture unit of the palette texture buffer, above the units Mesh::BindTextures hands out
+#define PALETTE_TEXTURE_UNIT 15
+
+//------------------------------------------------------
+// BONE PALETTE CLASS
+//------------------------------------------------------
+
+// The bone palettes of res/shaders/vertex.shader for any number of instances, read through the
+// RGBA32F texture buffer bonePalette: a bone matrix is 3 texels (the rows of its affine part,
+// see convertMatrix), a dual quaternion 2 (real and dual part, the glm::mat2x4_cast layout).
+// Every instance of a frame has its matrices followed by its dual quaternions, only the ones
+// the frame's skinning mode reads, and a draw selects its instance through the
+// boneMatricesBase and boneDualQuatsBase uniforms, so the bone count is only limited by
+// GL_MAX_TEXTURE_BUFFER_SIZE. The buffer is a ring of PALETTE_FRAMES such frames.
+//
+// With ARB_buffer_storage the buffer is mapped once, persistently and coherently, and a frame
+// is only written again after the fence placed behind its draws has signaled. Otherwise every
+// frame is mapped unsynchronized, and the buffer is orphaned whenever the ring wraps so the
+// driver hands out fresh storage instead of stalling. Either way the palettes are written in
+// place, e.g. by Model::BoneTransform, without a copy or an upload call.
+//
+// Per frame: BeginFrame, write the instances, EndWrites, Bind and draw each instance, EndFrame.
+class BonePalette
+{
+  public:
+    // whether the current context can keep the buffer mapped (ARB_buffer_storage or GL 4.4)
+    static bool HasPersistentMapping();
+
+    // most bones per palette the texture buffer can hold for i_numInstances instances
+    static unsigned int GetMaxBones(unsigned int i_numInstances = 1);
+
+    // Ctor, palettes of i_numBones bones for i_numInstances instances per frame. Needs a
+    // current context, i_numBones must not exceed GetMaxBones(i_numInstances): check it first
+    // and skin another way otherwise, as Application does.
+    explicit BonePalette(unsigned int i_numBones, unsigned int i_numInstances = 1);
+
+    BonePalette(const BonePalette& i_palette) = delete;
+    BonePalette& operator=(const BonePalette& i_palette) = delete;
+
+    // Dtor, unmaps the buffer and deletes the fences, the buffer and texture delete themselves
+    ~BonePalette();
+
+    // point the bonePalette sampler of a program at PALETTE_TEXTURE_UNIT, once after linking.
+    // Leaves the program in use.
+    static void BindSampler(Shader& i_shader);
+
+    // make the next frame of the ring writable, waits if the GPU still reads it. The frame only
+    // holds the palettes i_mode reads: 48 bytes per bone for LBS, 32 for DQS, 80 for hybrid.
+    void BeginFrame(SkinningMode i_mode);
+
+    // palette memory of an instance in the current frame, GetNumBones() entries each, null when
+    // the frame's mode does not read it. Only valid between BeginFrame and EndWrites. Mapped
+    // memory: write it, never read it back.
+    glm::mat3x4* GetMatrices(unsigned int i_instance);
+    glm::mat2x4* GetDualQuats(unsigned int i_instance);
+
+    // copy the palettes of Model::BoneTransform that the frame's mode reads into an instance
+    void Write(unsigned int i_instance, const std::vector<glm::mat4>& i_transforms,
+               const std::vector<glm::fdualquat>& i_dqs);
+
+    // done writing the current frame, call before its first draw
+    void EndWrites();
+
+    // bind the palette texture and point the base uniforms of the shader, which must be in use,
+    // at an instance in the current frame for the next draws
+    void Bind(unsigned int i_instance, const Shader& i_shader) const;
+
+    // fence the current frame after its last draw and move to the next one
+    void EndFrame();
+
+    unsigned int GetNumBones() const
+    {
+        return m_numBones;
+    }
+
+    bool IsPersistent() const
+    {
+        return m_persistent;
+    }
+
+  private:
+    // RGBA32F texels per bone: a mat3x4 is 3 rows, a mat2x4 is 2 columns
+    static constexpr unsigned int MATRIX_TEXELS = 3;
+    static constexpr unsigned int DUAL_QUAT_TEXELS = 2;
+    static constexpr unsigned int TEXEL_SIZE = 4 * sizeof(float);
+
+    // first texel of an instance's palettes inside a frame
+    unsigned int getMatricesTexel(unsigned int i_instance) const
+    {
+        return i_instance * m_instanceTexels;
+    }
+
+    unsigned int getDualQuatsTexel(unsigned int i_instance) const
+    {
+        return i_instance * m_instanceTexels + m_matricesTexels;
+    }
+
+    unsigned int m_numBones = 0;
+    unsigned int m_numInstances = 0;
+    bool m_persistent = false;
+
+    GpuResource m_TBO;
+    GpuResource m_texture;
+    // bytes of a frame in the ring, enough for both palettes of every instance
+    unsigned int m_frameSize = 0;
+
+    // layout of the current frame, set by BeginFrame for its mode
+    SkinningMode m_mode = SkinningMode::Hybrid;
+    // texels of an instance's matrices and of all its palettes
+    unsigned int m_matricesTexels = 0;
+    unsigned int m_instanceTexels = 0;
+
+    unsigned int m_frame = 0;
+    // start of the current frame in mapped memory, null while it is not writable
+    unsigned char* m_frameData = nullptr;
+    // the whole ring, only with the persistent mapping
+    unsigned char* m_mapped = nullptr;
+    // signaled once the GPU is done with the draws of each frame
+    GLsync m_fences[PALETTE_FRAMES] = {};
+};
@@ -0,0 +1,250 @@
+#include "ComputeSkinner.h"
+
+#include <cassert>
+
+//----------------------------------------------------------------
+
+bool ComputeSkinner::IsSupported()
+{
+    // the context may be newer than requested, the core 3.2 hint only sets a minimum
+    GLint major = 0;
+    GLint minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    const bool version43 = major > 4 || (major == 4 && minor >= 3);
+    return version43 && glDispatchCompute != nullptr && glBindBufferBase != nullptr;
+}
+
+//----------------------------------------------------------------
+
+ComputeSkinner::ComputeSkinner(const Model& i_model, unsigned int i_numInstances,
+                               const char* i_computePath)
+    : m_model(i_model), m_numInstances(i_numInstances), m_numBones(i_model.m_NumBones)
+{
+    assert(m_numInstances > 0);
+
+    // every mesh of the model encodes its bone data the same way, see Model::processMesh
+    const std::vector<Mesh>& meshes = m_model.GetMeshes();
+    const BoneEncoding encoding =
+        meshes.empty() ? GetBoneEncoding(m_numBones) : meshes[0].GetBoneEncoding();
+    const unsigned int stride = encoding.GetStride();
+
+    const SkinningMode modes[] = {SkinningMode::LBS, SkinningMode::DQS, SkinningMode::Hybrid};
+    for (SkinningMode mode : modes)
+    {
+        for (unsigned int b = 0; b < NUM_INFLUENCE_BUCKETS; ++b)
+        {
+            const std::string influences =
+                "SKINNING_INFLUENCES " + std::to_string(GetBucketInfluences(b));
+            ShaderDefines defines{{GetSkinningDefine(mode), influences}};
+            if (encoding.wideIndices)
+            {
+                defines.names.push_back("SKINNING_WIDE_INDICES");
+            }
+            if (encoding.wideWeights)
+            {
+                defines.names.push_back("SKINNING_WIDE_WEIGHTS");
+            }
+            m_programs.emplace_back(i_computePath, defines);
+        }
+    }
+
+    // the buckets of all meshes one after the other, so a bucket is one contiguous range
+    m_meshRanges.resize(meshes.size());
+    std::vector<Vertex> vertices;
+    std::vector<unsigned char> boneData;
+    for (unsigned int b = 0; b < NUM_INFLUENCE_BUCKETS; ++b)
+    {
+        m_bucketRanges[b].firstVertex = static_cast<unsigned int>(vertices.size());
+        for (unsigned int i = 0; i < meshes.size(); ++i)
+        {
+            const InfluenceRange& range = meshes[i].GetInfluenceRange(b);
+            m_meshRanges[i].bucketStarts[b] = static_cast<unsigned int>(vertices.size());
+            vertices.insert(vertices.end(), meshes[i].GetVertices().begin() + range.firstVertex,
+                            meshes[i].GetVertices().begin() + range.firstVertex +
+                                range.numVertices);
+            assert(meshes[i].GetBoneEncoding().wideIndices == encoding.wideIndices &&
+                   meshes[i].GetBoneEncoding().wideWeights == encoding.wideWeights);
+            const std::vector<unsigned char>& packed = meshes[i].GetPackedBoneData();
+            boneData.insert(boneData.end(), packed.begin() + range.firstVertex * stride,
+                            packed.begin() + (range.firstVertex + range.numVertices) * stride);
+        }
+        m_bucketRanges[b].numVertices =
+            static_cast<unsigned int>(vertices.size()) - m_bucketRanges[b].firstVertex;
+    }
+    m_numVertices = static_cast<unsigned int>(vertices.size());
+
+    // Draw only adds the base vertex of the instance
+    std::vector<unsigned int> indices;
+    for (unsigned int i = 0; i < meshes.size(); ++i)
+    {
+        m_meshRanges[i].firstIndex = static_cast<unsigned int>(indices.size());
+        m_meshRanges[i].numIndices = static_cast<unsigned int>(meshes[i].GetIndices().size());
+        for (unsigned int index : meshes[i].GetIndices())
+        {
+            indices.push_back(GetOutputVertex(i, index));
+        }
+    }
+
+    m_vertices_ssbo = GpuResource(GpuResourceType::Buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_vertices_ssbo.Get());
+    glBufferData(GL_SHADER_STORAGE_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(),
+                 GL_STATIC_DRAW);
+
+    m_boneData_ssbo = GpuResource(GpuResourceType::Buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_boneData_ssbo.Get());
+    glBufferData(GL_SHADER_STORAGE_BUFFER, boneData.size(), boneData.data(), GL_STATIC_DRAW);
+
+    // palettes of all instances, filled by SetPalette every frame
+    m_bones_ssbo = GpuResource(GpuResourceType::Buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_bones_ssbo.Get());
+    glBufferData(GL_SHADER_STORAGE_BUFFER, m_numInstances * m_numBones * sizeof(glm::mat3x4),
+                 nullptr, GL_DYNAMIC_DRAW);
+
+    m_dqs_ssbo = GpuResource(GpuResourceType::Buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_dqs_ssbo.Get());
+    glBufferData(GL_SHADER_STORAGE_BUFFER, m_numInstances * m_numBones * sizeof(glm::mat2x4),
+                 nullptr, GL_DYNAMIC_DRAW);
+
+    m_skinned_ssbo = GpuResource(GpuResourceType::Buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_skinned_ssbo.Get());
+    glBufferData(GL_SHADER_STORAGE_BUFFER,
+                 m_numInstances * m_numVertices * sizeof(SkinnedVertex), nullptr,
+                 GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    // one VAO for all meshes and instances, they only differ in first index and base vertex
+    m_VAO = GpuResource(GpuResourceType::VertexArray);
+    glBindVertexArray(m_VAO.Get());
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_skinned_ssbo.Get());
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(SkinnedVertex), (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(SkinnedVertex),
+                          (void*)offsetof(SkinnedVertex, Normal));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(SkinnedVertex),
+                          (void*)offsetof(SkinnedVertex, TexCoords));
+
+    m_EBO = GpuResource(GpuResourceType::Buffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO.Get());
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(),
+                 GL_STATIC_DRAW);
+    glBindVertexArray(0);
+
+    std::cout << "[ComputeSkinner] " << m_numVertices << " vertices in " << m_meshRanges.size()
+              << " meshes, " << m_numInstances << " instances" << std::endl;
+}
+
+//----------------------------------------------------------------
+
+void ComputeSkinner::SetPalette(unsigned int i_instance,
+                                const std::vector<glm::mat4>& i_transforms,
+                                const std::vector<glm::fdualquat>& i_dqs, SkinningMode i_mode)
+{
+    assert(i_instance < m_numInstances);
+
+    if (i_mode != SkinningMode::DQS)
+    {
+        assert(i_transforms.size() >= m_numBones);
+        // 3 rows per bone, the last row of an affine matrix is not uploaded
+        m_matrixScratch.resize(m_numBones);
+        for (unsigned int i = 0; i < m_numBones; ++i)
+        {
+            m_matrixScratch[i] = convertMatrix(i_transforms[i]);
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_bones_ssbo.Get());
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, i_instance * m_numBones * sizeof(glm::mat3x4),
+                        m_numBones * sizeof(glm::mat3x4), m_matrixScratch.data());
+    }
+
+    if (i_mode != SkinningMode::LBS)
+    {
+        assert(i_dqs.size() >= m_numBones);
+        // same layout as the dual quaternions of BonePalette
+        m_dqScratch.resize(m_numBones);
+        for (unsigned int i = 0; i < m_numBones; ++i)
+        {
+            m_dqScratch[i] = glm::mat2x4_cast(i_dqs[i]);
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_dqs_ssbo.Get());
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, i_instance * m_numBones * sizeof(glm::mat2x4),
+                        m_numBones * sizeof(glm::mat2x4), m_dqScratch.data());
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+//----------------------------------------------------------------
+
+void ComputeSkinner::Dispatch(SkinningMode i_mode, float i_ratio)
+{
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_vertices_ssbo.Get());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_boneData_ssbo.Get());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_bones_ssbo.Get());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, m_dqs_ssbo.Get());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, m_skinned_ssbo.Get());
+
+    for (unsigned int b = 0; b < NUM_INFLUENCE_BUCKETS; ++b)
+    {
+        const InfluenceRange& range = m_bucketRanges[b];
+        if (range.numVertices == 0)
+        {
+            continue;
+        }
+
+        Shader& program = m_programs[static_cast<int>(i_mode) * NUM_INFLUENCE_BUCKETS + b];
+        program.use();
+        program.setInt("numVertices", m_numVertices);
+        program.setInt("numInstances", m_numInstances);
+        program.setInt("numBones", m_numBones);
+        program.setInt("firstVertex", range.firstVertex);
+        program.setInt("bucketVertices", range.numVertices);
+        program.setFloat("ratio", i_ratio);
+
+        const unsigned int numThreads = m_numInstances * range.numVertices;
+        glDispatchCompute((numThreads + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+    }
+
+    // the output is read as vertex attributes by the next draws
+    glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+}
+
+//----------------------------------------------------------------
+
+void ComputeSkinner::Draw(unsigned int i_instance, const Shader& i_shader) const
+{
+    assert(i_instance < m_numInstances);
+
+    glBindVertexArray(m_VAO.Get());
+    const std::vector<Mesh>& meshes = m_model.GetMeshes();
+    for (unsigned int i = 0; i < m_meshRanges.size(); ++i)
+    {
+        const MeshRange& range = m_meshRanges[i];
+        meshes[i].BindTextures(i_shader);
+        glDrawElementsBaseVertex(GL_TRIANGLES, range.numIndices, GL_UNSIGNED_INT,
+                                 (void*)(range.firstIndex * sizeof(unsigned int)),
+                                 i_instance * m_numVertices);
+    }
+    glBindVertexArray(0);
+
+    glActiveTexture(GL_TEXTURE0);
+}
+
+//----------------------------------------------------------------
+
+unsigned int ComputeSkinner::GetOutputVertex(unsigned int i_mesh, unsigned int i_vertex) const
+{
+    const Mesh& mesh = m_model.GetMeshes()[i_mesh];
+    unsigned int b = 0;
+    while (b + 1 < NUM_INFLUENCE_BUCKETS)
+    {
+        const InfluenceRange& range = mesh.GetInfluenceRange(b);
+        if (i_vertex < range.firstVertex + range.numVertices)
+        {
+            break;
+        }
+        ++b;
+    }
+    return m_meshRanges[i_mesh].bucketStarts[b] + i_vertex - mesh.GetInfluenceRange(b).firstVertex;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "Model.h"
+#include "Shader.h"
+
+#include <vector>
+
+//------------------------------------------------------
+// COMPUTE SKINNER CLASS
+//------------------------------------------------------
+
+// Skins every mesh of one or more instances of a model with a compute shader (GL 4.3). The bind
+// pose vertices and the packed bone data (Mesh::GetPackedBoneData) of all meshes are uploaded
+// once into storage buffers, grouped by influence bucket across the meshes, and the palettes of
+// all instances are concatenated. One dispatch per bucket, with the program specialized for its
+// influence count and bone encoding, writes the SkinnedVertex output of every instance into a
+// single buffer that Draw feeds to res/shaders/skinned.vs.
+class ComputeSkinner
+{
+  public:
+    // whether the current context can run compute shaders on storage buffers
+    static bool IsSupported();
+
+    // Ctor, needs a current context for which IsSupported holds
+    ComputeSkinner(const Model& i_model, unsigned int i_numInstances = 1,
+                   const char* i_computePath = "res/shaders/skinning.comp");
+
+    ComputeSkinner(const ComputeSkinner& i_skinner) = delete;
+    ComputeSkinner& operator=(const ComputeSkinner& i_skinner) = delete;
+
+    // upload the palettes of Model::BoneTransform for one instance, only the ones i_mode reads
+    void SetPalette(unsigned int i_instance, const std::vector<glm::mat4>& i_transforms,
+                    const std::vector<glm::fdualquat>& i_dqs, SkinningMode i_mode);
+
+    // skin all instances with the palettes set so far, with the program compiled for i_mode
+    void Dispatch(SkinningMode i_mode, float i_ratio);
+
+    // draw every mesh of one instance from the output of the last Dispatch
+    void Draw(unsigned int i_instance, const Shader& i_shader) const;
+
+    unsigned int GetNumVertices() const
+    {
+        return m_numVertices;
+    }
+
+    unsigned int GetNumInstances() const
+    {
+        return m_numInstances;
+    }
+
+    // SkinnedVertex buffer, instance i starts at vertex i * GetNumVertices()
+    unsigned int GetOutputBuffer() const
+    {
+        return m_skinned_ssbo.Get();
+    }
+
+    // position of a vertex of a mesh inside the output of an instance
+    unsigned int GetOutputVertex(unsigned int i_mesh, unsigned int i_vertex) const;
+
+  private:
+    static constexpr unsigned int WORKGROUP_SIZE = 64;
+
+    // one mesh in the concatenated buffers. Its vertices of bucket b start at
+    // bucketStarts[b], its indices refer to the concatenated vertices.
+    struct MeshRange
+    {
+        unsigned int bucketStarts[NUM_INFLUENCE_BUCKETS] = {};
+        unsigned int firstIndex = 0;
+        unsigned int numIndices = 0;
+    };
+
+    const Model& m_model;
+    // one variant per SkinningMode and influence bucket, at mode * NUM_INFLUENCE_BUCKETS + bucket
+    std::vector<Shader> m_programs;
+
+    unsigned int m_numInstances = 0;
+    unsigned int m_numVertices = 0;
+    unsigned int m_numBones = 0;
+    std::vector<MeshRange> m_meshRanges;
+    // vertices of every bucket across all meshes
+    InfluenceRange m_bucketRanges[NUM_INFLUENCE_BUCKETS];
+    std::vector<glm::mat3x4> m_matrixScratch;
+    std::vector<glm::mat2x4> m_dqScratch;
+
+    GpuResource m_vertices_ssbo;
+    GpuResource m_boneData_ssbo;
+    GpuResource m_bones_ssbo;
+    GpuResource m_dqs_ssbo;
+    GpuResource m_skinned_ssbo;
+    GpuResource m_EBO;
+    GpuResource m_VAO;
+};
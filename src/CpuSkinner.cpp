@@ -0,0 +1,133 @@
+#include "CpuSkinner.h"
+
+#include <chrono>
+
+//----------------------------------------------------------------
+
+std::vector<WorkerScaling> CpuSkinner::SweepWorkers(const Model& i_model,
+                                                    unsigned int i_maxWorkers,
+                                                    const std::vector<glm::mat4>& i_transforms,
+                                                    const std::vector<glm::fdualquat>& i_dqs,
+                                                    SkinningMode i_mode, float i_ratio,
+                                                    unsigned int i_iterations)
+{
+    if (i_maxWorkers == 0)
+    {
+        i_maxWorkers = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    std::vector<WorkerScaling> results;
+    for (unsigned int n = 1; n <= i_maxWorkers; ++n)
+    {
+        WorkerPool pool(n);
+        CpuSkinner skinner(i_model, pool);
+
+        // the first call warms the caches and wakes the threads
+        skinner.Skin(i_transforms, i_dqs, i_mode, i_ratio);
+        WorkerScaling result;
+        result.numWorkers = n;
+        for (unsigned int i = 0; i < i_iterations; ++i)
+        {
+            skinner.Skin(i_transforms, i_dqs, i_mode, i_ratio);
+            result.microseconds += skinner.GetSkinMicroseconds();
+        }
+        result.microseconds /= std::max(i_iterations, 1u);
+        result.speedup = results.empty() ? 1.0f : results[0].microseconds / result.microseconds;
+        results.push_back(result);
+
+        // more workers than chunks cannot scale any further
+        std::cout << "[CpuSkinner] " << skinner.GetNumVertices() << " vertices in "
+                  << skinner.GetChunkTimings().size() << " chunks, " << GetSkinningDefine(i_mode)
+                  << ": " << result.microseconds << " us on " << n << " workers, speedup "
+                  << result.speedup << ", efficiency " << result.speedup / n << std::endl;
+    }
+    return results;
+}
+
+//----------------------------------------------------------------
+
+CpuSkinner::CpuSkinner(const Model& i_model, WorkerPool& i_pool, unsigned int i_chunkSize)
+    : m_pool(i_pool), m_simdLevel(GetSimdLevel())
+{
+    for (const Mesh& mesh : i_model.GetMeshes())
+    {
+        m_meshOffsets.push_back(AppendSkinningStreams(mesh, m_streams));
+        m_numVertices += static_cast<unsigned int>(mesh.GetVertices().size());
+    }
+    ResizeSkinnedStreams(m_streams, m_output);
+
+    m_skinnedVertices.resize(m_streams.GetSize());
+    for (unsigned int m = 0; m < i_model.GetMeshes().size(); ++m)
+    {
+        const std::vector<Vertex>& vertices = i_model.GetMeshes()[m].GetVertices();
+        for (unsigned int i = 0; i < vertices.size(); ++i)
+        {
+            m_skinnedVertices[m_meshOffsets[m] + i].TexCoords = vertices[i].TexCoords;
+        }
+    }
+
+    // chunk bounds have to stay on the kernel width
+    const unsigned int chunkSize =
+        std::max(1u, i_chunkSize / SKINNING_MAX_LANES) * SKINNING_MAX_LANES;
+    for (unsigned int begin = 0; begin < m_streams.GetSize(); begin += chunkSize)
+    {
+        ChunkTiming chunk;
+        chunk.begin = begin;
+        chunk.end = std::min(begin + chunkSize, m_streams.GetSize());
+        m_chunks.push_back(chunk);
+    }
+
+    std::cout << "[CpuSkinner] " << m_numVertices << " vertices in " << m_chunks.size()
+              << " chunks, " << m_pool.GetNumWorkers() << " workers, "
+              << GetSimdLevelName(m_simdLevel) << " kernel" << std::endl;
+}
+
+//----------------------------------------------------------------
+
+void CpuSkinner::Skin(const std::vector<glm::mat4>& i_transforms,
+                      const std::vector<glm::fdualquat>& i_dqs, SkinningMode i_mode,
+                      float i_ratio)
+{
+    // the palette keeps its capacity from frame to frame
+    BuildSkinningPalette(i_transforms, i_dqs, i_mode, m_palette);
+    m_mode = i_mode;
+    m_ratio = i_ratio;
+
+    auto start = std::chrono::steady_clock::now();
+    m_pool.Run(static_cast<unsigned int>(m_chunks.size()), &CpuSkinner::skinChunk, this);
+    auto end = std::chrono::steady_clock::now();
+    m_skinMicroseconds = std::chrono::duration<float, std::micro>(end - start).count();
+}
+
+//----------------------------------------------------------------
+
+void CpuSkinner::Upload(Model& io_model)
+{
+    for (unsigned int v = 0; v < m_skinnedVertices.size(); ++v)
+    {
+        SkinnedVertex& vertex = m_skinnedVertices[v];
+        vertex.Position = glm::vec3(m_output.px[v], m_output.py[v], m_output.pz[v]);
+        vertex.Normal = glm::vec3(m_output.nx[v], m_output.ny[v], m_output.nz[v]);
+    }
+
+    for (unsigned int m = 0; m < m_meshOffsets.size(); ++m)
+    {
+        io_model.UploadSkinned(m, m_skinnedVertices.data() + m_meshOffsets[m]);
+    }
+}
+
+//----------------------------------------------------------------
+
+void CpuSkinner::skinChunk(void* i_context, unsigned int i_chunk, unsigned int i_worker)
+{
+    CpuSkinner& skinner = *static_cast<CpuSkinner*>(i_context);
+    ChunkTiming& chunk = skinner.m_chunks[i_chunk];
+
+    auto start = std::chrono::steady_clock::now();
+    SkinStreams(skinner.m_streams, skinner.m_palette, skinner.m_mode, skinner.m_ratio,
+                chunk.begin, chunk.end, skinner.m_output, skinner.m_simdLevel);
+    auto end = std::chrono::steady_clock::now();
+
+    chunk.worker = i_worker;
+    chunk.microseconds = std::chrono::duration<float, std::micro>(end - start).count();
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "Model.h"
+#include "SkinningSIMD.h"
+#include "WorkerPool.h"
+
+#include <vector>
+
+// Vertices per chunk: about 80 bytes of input and output per vertex keeps a chunk in L2
+#define SKINNING_CHUNK_SIZE 1024
+
+//------------------------------------------------------
+// CHUNK TIMING
+//------------------------------------------------------
+
+struct ChunkTiming
+{
+    unsigned int begin = 0;
+    unsigned int end = 0;
+    // worker that ran the chunk, 0 is the calling thread
+    unsigned int worker = 0;
+    float microseconds = 0.0f;
+};
+
+//------------------------------------------------------
+// WORKER SCALING
+//------------------------------------------------------
+
+// average Skin time on a pool of numWorkers workers, speedup is relative to 1 worker
+struct WorkerScaling
+{
+    unsigned int numWorkers = 0;
+    float microseconds = 0.0f;
+    float speedup = 0.0f;
+};
+
+//------------------------------------------------------
+// CPU SKINNER CLASS
+//------------------------------------------------------
+
+// Skins every mesh of a model on the CPU. The vertices of all meshes are concatenated into one
+// set of SIMD streams and cut into chunks that the worker pool distributes, so the load stays
+// balanced however the vertices are spread over the meshes. All buffers are sized up front,
+// Skin allocates nothing.
+class CpuSkinner
+{
+  public:
+    // Skin the model i_iterations times on pools of 1 to i_maxWorkers workers (0 for one per
+    // hardware thread) with the palettes of Model::BoneTransform. Logs and returns the average
+    // time and the speedup over 1 worker of every count. Rerun to measure after a change.
+    static std::vector<WorkerScaling> SweepWorkers(const Model& i_model, unsigned int i_maxWorkers,
+                                                   const std::vector<glm::mat4>& i_transforms,
+                                                   const std::vector<glm::fdualquat>& i_dqs,
+                                                   SkinningMode i_mode, float i_ratio,
+                                                   unsigned int i_iterations);
+
+    // Ctor
+    CpuSkinner(const Model& i_model, WorkerPool& i_pool,
+               unsigned int i_chunkSize = SKINNING_CHUNK_SIZE);
+
+    CpuSkinner(const CpuSkinner& i_skinner) = delete;
+
+    // skin all meshes with the palettes of Model::BoneTransform
+    void Skin(const std::vector<glm::mat4>& i_transforms,
+              const std::vector<glm::fdualquat>& i_dqs, SkinningMode i_mode, float i_ratio);
+
+    // interleave the output of the last Skin call and upload it for Model::DrawSkinned
+    void Upload(Model& io_model);
+
+    // skinned positions and normals of all meshes
+    const SkinnedStreams& GetOutput() const
+    {
+        return m_output;
+    }
+
+    // first vertex of a mesh in the output streams, its vertices follow contiguously
+    unsigned int GetMeshOffset(unsigned int i_mesh) const
+    {
+        return m_meshOffsets[i_mesh];
+    }
+
+    unsigned int GetNumVertices() const
+    {
+        return m_numVertices;
+    }
+
+    // timings of the chunks of the last Skin call
+    const std::vector<ChunkTiming>& GetChunkTimings() const
+    {
+        return m_chunks;
+    }
+
+    // wall time of the last Skin call, including the hand out to the workers
+    float GetSkinMicroseconds() const
+    {
+        return m_skinMicroseconds;
+    }
+
+    unsigned int GetNumWorkers() const
+    {
+        return m_pool.GetNumWorkers();
+    }
+
+    // kernel of the next Skin calls, GetSimdLevel() until changed, e.g. to fall back to the
+    // scalar kernel. Higher levels than GetSimdLevel() may not run on the CPU.
+    void SetSimdLevel(SimdLevel i_level)
+    {
+        m_simdLevel = i_level;
+    }
+
+  private:
+    // WorkerPool task, skins one chunk
+    static void skinChunk(void* i_context, unsigned int i_chunk, unsigned int i_worker);
+
+    WorkerPool& m_pool;
+    SimdLevel m_simdLevel;
+
+    SkinningStreams m_streams;
+    SkinnedStreams m_output;
+    // upload staging, indexed like the streams. The texture coordinates are set once.
+    std::vector<SkinnedVertex> m_skinnedVertices;
+    std::vector<unsigned int> m_meshOffsets;
+    unsigned int m_numVertices = 0;
+
+    std::vector<ChunkTiming> m_chunks;
+    float m_skinMicroseconds = 0.0f;
+
+    // state of the running Skin call, read by the workers
+    SkinningPalette m_palette;
+    SkinningMode m_mode = SkinningMode::LBS;
+    float m_ratio = 0.0f;
+};
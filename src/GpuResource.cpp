@@ -0,0 +1,139 @@
+#include "GpuResource.h"
+
+#include <iostream>
+
+namespace
+{
+const unsigned int NUM_TYPES = static_cast<unsigned int>(GpuResourceType::Count);
+const char* const TYPE_NAMES[NUM_TYPES] = {"buffers", "vertex arrays", "textures",
+                                             "programs"};
+
+// GL objects are only touched from the thread owning the context, no atomics needed
+unsigned int s_numLive[NUM_TYPES] = {};
+unsigned int s_numCreated[NUM_TYPES] = {};
+} // namespace
+
+//----------------------------------------------------------------
+
+GpuResource::GpuResource(GpuResourceType i_type) : m_type(i_type)
+{
+    switch (m_type)
+    {
+    case GpuResourceType::Buffer:
+        glGenBuffers(1, &m_id);
+        break;
+    case GpuResourceType::VertexArray:
+        glGenVertexArrays(1, &m_id);
+        break;
+    case GpuResourceType::Texture:
+        glGenTextures(1, &m_id);
+        break;
+    case GpuResourceType::Program:
+        m_id = glCreateProgram();
+        break;
+    default:
+        return;
+    }
+
+    ++s_numLive[static_cast<unsigned int>(m_type)];
+    ++s_numCreated[static_cast<unsigned int>(m_type)];
+}
+
+//----------------------------------------------------------------
+
+GpuResource::GpuResource(GpuResource&& io_resource) noexcept
+    : m_type(io_resource.m_type), m_id(io_resource.m_id)
+{
+    io_resource.m_id = 0;
+}
+
+//----------------------------------------------------------------
+
+GpuResource& GpuResource::operator=(GpuResource&& io_resource) noexcept
+{
+    if (this != &io_resource)
+    {
+        Reset();
+        m_type = io_resource.m_type;
+        m_id = io_resource.m_id;
+        io_resource.m_id = 0;
+    }
+    return *this;
+}
+
+//----------------------------------------------------------------
+
+GpuResource::~GpuResource()
+{
+    Reset();
+}
+
+//----------------------------------------------------------------
+
+void GpuResource::Reset()
+{
+    if (m_id == 0)
+    {
+        return;
+    }
+
+    switch (m_type)
+    {
+    case GpuResourceType::Buffer:
+        glDeleteBuffers(1, &m_id);
+        break;
+    case GpuResourceType::VertexArray:
+        glDeleteVertexArrays(1, &m_id);
+        break;
+    case GpuResourceType::Texture:
+        glDeleteTextures(1, &m_id);
+        break;
+    case GpuResourceType::Program:
+        glDeleteProgram(m_id);
+        break;
+    default:
+        break;
+    }
+
+    --s_numLive[static_cast<unsigned int>(m_type)];
+    m_id = 0;
+}
+
+//----------------------------------------------------------------
+
+unsigned int GpuResource::GetNumLive(GpuResourceType i_type)
+{
+    return s_numLive[static_cast<unsigned int>(i_type)];
+}
+
+//----------------------------------------------------------------
+
+unsigned int GpuResource::GetNumCreated(GpuResourceType i_type)
+{
+    return s_numCreated[static_cast<unsigned int>(i_type)];
+}
+
+//----------------------------------------------------------------
+
+unsigned int GpuResource::ReportLeaks()
+{
+    unsigned int numLeaks = 0;
+    for (unsigned int t = 0; t < NUM_TYPES; ++t)
+    {
+        numLeaks += s_numLive[t];
+    }
+
+    if (numLeaks == 0)
+    {
+        std::cout << "[GpuResource] All GPU objects deleted" << std::endl;
+        return 0;
+    }
+
+    std::cout << "[GpuResource] Leaked";
+    for (unsigned int t = 0; t < NUM_TYPES; ++t)
+    {
+        std::cout << " " << s_numLive[t] << " " << TYPE_NAMES[t] << (t + 1 < NUM_TYPES ? "," : "");
+    }
+    std::cout << std::endl;
+    return numLeaks;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <GL/glew.h>
+
+//------------------------------------------------------
+// GPU RESOURCE CLASS
+//------------------------------------------------------
+
+enum class GpuResourceType
+{
+    Buffer,
+    VertexArray,
+    Texture,
+    Program,
+    Count
+};
+
+// Owns one GL object name: the ctor generates it, the dtor deletes it, so the object lives
+// exactly as long as its owner. Moves only, a moved-from resource holds no object. Every
+// generated and deleted object is counted per type, so a frame that creates objects or an
+// owner that outlives its context shows up in GetNumCreated / ReportLeaks.
+//
+// All calls need the context the object was created in to be current.
+class GpuResource
+{
+  public:
+    // no object
+    GpuResource() = default;
+
+    // generate an object of the type
+    explicit GpuResource(GpuResourceType i_type);
+
+    GpuResource(const GpuResource& i_resource) = delete;
+    GpuResource& operator=(const GpuResource& i_resource) = delete;
+
+    GpuResource(GpuResource&& io_resource) noexcept;
+    GpuResource& operator=(GpuResource&& io_resource) noexcept;
+
+    // Dtor, deletes the object
+    ~GpuResource();
+
+    // delete the object now, the resource then holds none
+    void Reset();
+
+    // GL name of the object, 0 without one
+    unsigned int Get() const
+    {
+        return m_id;
+    }
+
+    GpuResourceType GetType() const
+    {
+        return m_type;
+    }
+
+    explicit operator bool() const
+    {
+        return m_id != 0;
+    }
+
+    // objects of a type alive right now, across all owners
+    static unsigned int GetNumLive(GpuResourceType i_type);
+
+    // objects of a type generated since startup, constant once loading is done
+    static unsigned int GetNumCreated(GpuResourceType i_type);
+
+    // log the objects of every type still alive, returns their total. Call once all owners are
+    // destroyed and before the context is.
+    static unsigned int ReportLeaks();
+
+  private:
+    GpuResourceType m_type = GpuResourceType::Buffer;
+    unsigned int m_id = 0;
+};
@@ -40,20 +40,20 @@ glm::vec3 Lamp::getColor()
 
 void Lamp::setupLight()
 {
-    glGenVertexArrays(1, &m_lightVAO);
-    glBindVertexArray(m_lightVAO);
-    glGenBuffers(1, &m_lightVBO);
-    glBindBuffer(GL_ARRAY_BUFFER, m_lightVBO);
+    m_lightVAO = GpuResource(GpuResourceType::VertexArray);
+    glBindVertexArray(m_lightVAO.Get());
+    m_lightVBO = GpuResource(GpuResourceType::Buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, m_lightVBO.Get());
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
 }
 
-void Lamp::Draw(Shader* i_shader)
+void Lamp::Draw(Shader& i_shader)
 {
-    i_shader->use();
-    glBindVertexArray(m_lightVAO);
+    i_shader.use();
+    glBindVertexArray(m_lightVAO.Get());
     glDrawArrays(GL_TRIANGLES, 0, 36);
     glBindVertexArray(0);
 }
@@ -1,4 +1,5 @@
 #pragma once
+#include "GpuResource.h"
 #include "Shader.h"
 #include <glm.hpp>
 
@@ -14,7 +15,7 @@ class Lamp
     Lamp(Lamp&&) = delete;
 
     // Render the lamp
-    void Draw(Shader* i_shader);
+    void Draw(Shader& i_shader);
 
     vec3 getPosition();
     vec3 getColor();
@@ -25,6 +26,6 @@ class Lamp
     vec3 m_position;
     vec3 m_color;
 
-    unsigned int m_lightVAO = 0;
-    unsigned int m_lightVBO = 0;
+    GpuResource m_lightVAO;
+    GpuResource m_lightVBO;
 };
\ No newline at end of file
@@ -9,6 +9,9 @@
 
 #define DEBUG_PRINT() 0
 
+// set to 1 to check the direct TRS to dual quaternion path against the matrix round trip
+#define VALIDATE_DUALQUAT 0
+
 #define LOG_MATRIX(i_mat) logMatrix(i_mat)
 template <typename T> void logMatrix(T& i_mat44)
 {
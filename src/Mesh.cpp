@@ -1,17 +1,22 @@
 #include "Mesh.h"
 
+#include <algorithm>
+#include <cassert>
+
 using namespace std;
 
 void Mesh::SetVertices(const std::vector<Vertex>& i_vertices)
 {
     m_vertices.resize(i_vertices.size());
     m_vertices = i_vertices;
+    resetInfluenceRanges();
 }
 
 void Mesh::SetIndices(const std::vector<unsigned int>& i_indices)
 {
     m_indices.resize(i_indices.size());
     m_indices = i_indices;
+    resetInfluenceRanges();
 }
 
 void Mesh::SetTexture(const std::vector<Texture>& i_textures)
@@ -30,14 +35,216 @@ void Mesh::SetVertexBoneData(const std::vector<VertexBoneData>& i_vertexBoneData
 {
     m_vertexBoneData.resize(i_vertexBoneData.size());
     m_vertexBoneData = i_vertexBoneData;
+    resetInfluenceRanges();
+    packBoneData();
+}
+
+void Mesh::SetBoneEncoding(const BoneEncoding& i_encoding)
+{
+    m_boneEncoding = i_encoding;
+    packBoneData();
+}
+
+void Mesh::PartitionInfluences()
+{
+    assert(m_vertexBoneData.size() == m_vertices.size());
+
+    std::vector<unsigned int> vertexBuckets(m_vertices.size());
+    for (unsigned int v = 0; v < m_vertices.size(); ++v)
+    {
+        vertexBuckets[v] = GetInfluenceBucket(m_vertexBoneData[v].GetNumInfluences());
+    }
+
+    // stable order inside a bucket keeps the vertex cache locality of the original order
+    std::vector<unsigned int> order(m_vertices.size());
+    for (unsigned int v = 0; v < order.size(); ++v)
+    {
+        order[v] = v;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](unsigned int i_a, unsigned int i_b) {
+        return vertexBuckets[i_a] < vertexBuckets[i_b];
+    });
+
+    std::vector<Vertex> vertices(m_vertices.size());
+    std::vector<VertexBoneData> boneData(m_vertices.size());
+    std::vector<unsigned int> remap(m_vertices.size());
+    for (unsigned int v = 0; v < order.size(); ++v)
+    {
+        vertices[v] = m_vertices[order[v]];
+        boneData[v] = m_vertexBoneData[order[v]];
+        remap[order[v]] = v;
+    }
+
+    // a triangle goes with its highest vertex bucket, the shader then reads enough influences
+    // for all three corners
+    const unsigned int numTriangles = static_cast<unsigned int>(m_indices.size() / 3);
+    std::vector<unsigned int> triangleBuckets(numTriangles);
+    std::vector<unsigned int> triangles(numTriangles);
+    for (unsigned int t = 0; t < numTriangles; ++t)
+    {
+        triangleBuckets[t] = std::max({vertexBuckets[m_indices[3 * t]],
+                                       vertexBuckets[m_indices[3 * t + 1]],
+                                       vertexBuckets[m_indices[3 * t + 2]]});
+        triangles[t] = t;
+    }
+    std::stable_sort(triangles.begin(), triangles.end(), [&](unsigned int i_a, unsigned int i_b) {
+        return triangleBuckets[i_a] < triangleBuckets[i_b];
+    });
+
+    std::vector<unsigned int> indices(m_indices.size());
+    for (unsigned int t = 0; t < numTriangles; ++t)
+    {
+        for (unsigned int c = 0; c < 3; ++c)
+        {
+            indices[3 * t + c] = remap[m_indices[3 * triangles[t] + c]];
+        }
+    }
+
+    for (unsigned int b = 0; b < NUM_INFLUENCE_BUCKETS; ++b)
+    {
+        m_influenceRanges[b] = InfluenceRange();
+    }
+    for (unsigned int v = 0; v < order.size(); ++v)
+    {
+        ++m_influenceRanges[vertexBuckets[order[v]]].numVertices;
+    }
+    for (unsigned int t = 0; t < numTriangles; ++t)
+    {
+        m_influenceRanges[triangleBuckets[t]].numIndices += 3;
+    }
+    for (unsigned int b = 1; b < NUM_INFLUENCE_BUCKETS; ++b)
+    {
+        const InfluenceRange& previous = m_influenceRanges[b - 1];
+        m_influenceRanges[b].firstVertex = previous.firstVertex + previous.numVertices;
+        m_influenceRanges[b].firstIndex = previous.firstIndex + previous.numIndices;
+    }
+
+    m_vertices = vertices;
+    m_vertexBoneData = boneData;
+    m_indices = indices;
+    packBoneData();
+}
+
+void Mesh::packBoneData()
+{
+    m_packedBoneData.clear();
+    EncodeBoneData(m_vertexBoneData, m_boneEncoding, m_packedBoneData);
+}
+
+void Mesh::resetInfluenceRanges()
+{
+    for (unsigned int b = 0; b < NUM_INFLUENCE_BUCKETS; ++b)
+    {
+        m_influenceRanges[b] = InfluenceRange();
+    }
+
+    InfluenceRange& all = m_influenceRanges[NUM_INFLUENCE_BUCKETS - 1];
+    all.numVertices = static_cast<unsigned int>(m_vertices.size());
+    all.numIndices = static_cast<unsigned int>(m_indices.size());
 }
 
 // render the mesh
 void Mesh::Draw(const Shader& i_shader)
 {
-    // Set the vertex buffers and its attribute pointers.
-    this->InitializeBuffer();
+    // uploaded once, Model does it at load
+    if (!m_VAO)
+    {
+        InitializeBuffer();
+    }
 
+    BindTextures(i_shader);
+
+    // one range per influence bucket, the shader loops over numInfluences bones
+    glBindVertexArray(m_VAO.Get());
+    for (unsigned int b = 0; b < NUM_INFLUENCE_BUCKETS; ++b)
+    {
+        const InfluenceRange& range = m_influenceRanges[b];
+        if (range.numIndices == 0)
+        {
+            continue;
+        }
+        i_shader.setInt("numInfluences", GetBucketInfluences(b));
+        glDrawElements(GL_TRIANGLES, range.numIndices, GL_UNSIGNED_INT,
+                       (void*)(range.firstIndex * sizeof(unsigned int)));
+    }
+    glBindVertexArray(0);
+
+    // always good practice to set everything back to defaults once configured.
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void Mesh::SkinToFeedback()
+{
+    if (!m_VAO)
+    {
+        InitializeBuffer();
+    }
+    if (!m_feedback_vbo)
+    {
+        initializeFeedbackBuffer();
+    }
+
+    // one point per vertex, the indices are only needed when drawing the result. The draws of
+    // the buckets append to the feedback buffer in vertex order.
+    GLint program = 0;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+    const GLint numInfluences = glGetUniformLocation(program, "numInfluences");
+
+    glBindVertexArray(m_VAO.Get());
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, m_feedback_vbo.Get());
+    glBeginTransformFeedback(GL_POINTS);
+    for (unsigned int b = 0; b < NUM_INFLUENCE_BUCKETS; ++b)
+    {
+        const InfluenceRange& range = m_influenceRanges[b];
+        if (range.numVertices == 0)
+        {
+            continue;
+        }
+        glUniform1i(numInfluences, GetBucketInfluences(b));
+        glDrawArrays(GL_POINTS, range.firstVertex, range.numVertices);
+    }
+    glEndTransformFeedback();
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+    glBindVertexArray(0);
+}
+
+void Mesh::UploadSkinned(const SkinnedVertex* i_vertices)
+{
+    if (!m_VAO)
+    {
+        InitializeBuffer();
+    }
+    if (!m_feedback_vbo)
+    {
+        initializeFeedbackBuffer();
+    }
+
+    // respecified every frame, so the driver can hand out fresh storage instead of waiting for
+    // the draws of the last frame
+    glBindBuffer(GL_ARRAY_BUFFER, m_feedback_vbo.Get());
+    glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(SkinnedVertex), i_vertices,
+                 GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void Mesh::DrawSkinned(const Shader& i_shader)
+{
+    if (!m_skinnedVAO)
+    {
+        return;
+    }
+
+    BindTextures(i_shader);
+
+    glBindVertexArray(m_skinnedVAO.Get());
+    glDrawElements(GL_TRIANGLES, m_indices.size(), GL_UNSIGNED_INT, 0);
+    glBindVertexArray(0);
+
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void Mesh::BindTextures(const Shader& i_shader) const
+{
     // bind appropriate textures
     unsigned int diffuseNr = 1;
     unsigned int specularNr = 1;
@@ -70,35 +277,56 @@ void Mesh::Draw(const Shader& i_shader)
         // and finally bind the texture
         glBindTexture(GL_TEXTURE_2D, m_textures[i].id);
     }
+}
 
-    glBindVertexArray(m_VAO);
-    glDrawElements(GL_TRIANGLES, m_indices.size(), GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
+void Mesh::initializeFeedbackBuffer()
+{
+    m_feedback_vbo = GpuResource(GpuResourceType::Buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, m_feedback_vbo.Get());
+    glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(SkinnedVertex), nullptr,
+                 GL_DYNAMIC_COPY);
 
-    // always good practice to set everything back to defaults once configured.
-    glActiveTexture(GL_TEXTURE0);
+    // the indices are shared with the bind pose buffers
+    m_skinnedVAO = GpuResource(GpuResourceType::VertexArray);
+    glBindVertexArray(m_skinnedVAO.Get());
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(SkinnedVertex), (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(SkinnedVertex),
+                          (void*)offsetof(SkinnedVertex, Normal));
+
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(SkinnedVertex),
+                          (void*)offsetof(SkinnedVertex, TexCoords));
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO.Get());
+    glBindVertexArray(0);
 }
 
 void Mesh::InitializeBuffer()
 {
-    // create buffers/arrays
-    glGenVertexArrays(1, &m_VAO);
-    glGenBuffers(1, &m_vertexData_vbo);
-    glGenBuffers(1, &m_EBO);
-    glGenBuffers(1, &m_vertexBones_vbo);
+    // create buffers/arrays, only the first time: later calls upload into the same objects
+    if (!m_VAO)
+    {
+        m_VAO = GpuResource(GpuResourceType::VertexArray);
+        m_vertexData_vbo = GpuResource(GpuResourceType::Buffer);
+        m_EBO = GpuResource(GpuResourceType::Buffer);
+        m_vertexBones_vbo = GpuResource(GpuResourceType::Buffer);
+    }
 
-    glBindVertexArray(m_VAO);
+    glBindVertexArray(m_VAO.Get());
     // load data into vertex buffers
-    glBindBuffer(GL_ARRAY_BUFFER, m_vertexData_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vertexData_vbo.Get());
     // A great thing about structs is that their memory layout is sequential for all its items.
     // The effect is that we can simply pass a pointer to the struct and it translates perfectly to
     // a glm::vec3/2 array which again translates to 3/2 floats which translates to a byte array.
-    glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(Vertex), &m_vertices[0],
+    glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(Vertex), m_vertices.data(),
                  GL_STATIC_DRAW);
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_indices.size() * sizeof(unsigned int), &m_indices[0],
-                 GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO.Get());
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_indices.size() * sizeof(unsigned int),
+                 m_indices.data(), GL_STATIC_DRAW);
 
     // set the vertex attribute pointers
     // vertex Positions
@@ -121,14 +349,24 @@ void Mesh::InitializeBuffer()
     // glVertexAttribPointer( 4, 3, GL_FLOAT, GL_FALSE, sizeof( Vertex ), ( void* )offsetof( Vertex,
     // Bitangent ) );
 
-    glBindBuffer(GL_ARRAY_BUFFER, m_vertexBones_vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(VertexBoneData) * m_vertexBoneData.size(),
-                 &m_vertexBoneData[0], GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vertexBones_vbo.Get());
+    glBufferData(GL_ARRAY_BUFFER, m_packedBoneData.size(), m_packedBoneData.data(),
+                 GL_STATIC_DRAW);
+    // influences 0-3 and 4-7 as two uvec4 / vec4 pairs of 8 or 16-bit indices and normalized
+    // weights, the weight slot after influence 7 is padding
+    const GLsizei stride = m_boneEncoding.GetStride();
+    const GLenum indexType = m_boneEncoding.GetIndexType();
+    const GLenum weightType = m_boneEncoding.GetWeightType();
+    const size_t indices2 = 4 * m_boneEncoding.GetIndexSize();
+    const size_t weights = m_boneEncoding.GetWeightsOffset();
+    const size_t weights2 = weights + 4 * m_boneEncoding.GetWeightSize();
     glEnableVertexAttribArray(3);
-    glVertexAttribIPointer(3, 4, GL_INT, sizeof(VertexBoneData),
-                           (const GLvoid*)0); // Int values only
+    glVertexAttribIPointer(3, 4, indexType, stride, (const GLvoid*)0); // Int values only
     glEnableVertexAttribArray(4);
-    glVertexAttribPointer(4, NUM_BONES_PER_VERTEX, GL_FLOAT, GL_FALSE, sizeof(VertexBoneData),
-                          (void*)offsetof(VertexBoneData, Weights));
+    glVertexAttribPointer(4, 4, weightType, GL_TRUE, stride, (void*)weights);
+    glEnableVertexAttribArray(5);
+    glVertexAttribIPointer(5, 4, indexType, stride, (void*)indices2);
+    glEnableVertexAttribArray(6);
+    glVertexAttribPointer(6, 4, weightType, GL_TRUE, stride, (void*)weights2);
     glBindVertexArray(0);
 }
\ No newline at end of file
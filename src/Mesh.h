@@ -1,5 +1,6 @@
 #pragma once
 
+#include "GpuResource.h"
 #include "MeshData.inl"
 #include "Shader.h"
 #include <string>
@@ -17,6 +18,12 @@ class Mesh
     {
     }
 
+    // owns its GL objects, moves only
+    Mesh(const Mesh& i_mesh) = delete;
+    Mesh& operator=(const Mesh& i_mesh) = delete;
+    Mesh(Mesh&& io_mesh) = default;
+    Mesh& operator=(Mesh&& io_mesh) = default;
+
     // Draw  call - handle rendering the mesh
     void Draw(const Shader& i_shader);
 
@@ -30,18 +37,91 @@ class Mesh
 
     void SetVertexBoneData(const std::vector<VertexBoneData>& i_vertices);
 
-    // Initialize all buffer objects and arrays
+    // reorder the vertices by influence bucket and the triangles by the highest bucket of their
+    // vertices, so every bucket is one contiguous vertex range and one index range. Call once
+    // the vertices, indices and bone data are set.
+    void PartitionInfluences();
+
+    // pick the index and weight widths of the bone vertex buffer, see BoneEncoding
+    void SetBoneEncoding(const BoneEncoding& i_encoding);
+
+    // create the buffer objects and the VAO on the first call and upload the vertices, indices
+    // and packed bone data into them. Draw only binds the cached VAO, so call it again only
+    // after changing the mesh.
     void InitializeBuffer();
 
+    // run the bound transform feedback program over every vertex once, capturing the skinned
+    // vertices into the feedback buffer
+    void SkinToFeedback();
+
+    // upload vertices skinned on the CPU (e.g. by CpuSkinner) into the feedback buffer instead,
+    // one per mesh vertex, for DrawSkinned to draw
+    void UploadSkinned(const SkinnedVertex* i_vertices);
+
+    // draw the vertices captured by the last SkinToFeedback or UploadSkinned with a pass-through
+    // shader
+    void DrawSkinned(const Shader& i_shader);
+
+    const std::vector<Vertex>& GetVertices() const
+    {
+        return m_vertices;
+    }
+
+    const std::vector<unsigned int>& GetIndices() const
+    {
+        return m_indices;
+    }
+
+    const std::vector<VertexBoneData>& GetVertexBoneData() const
+    {
+        return m_vertexBoneData;
+    }
+
+    const BoneEncoding& GetBoneEncoding() const
+    {
+        return m_boneEncoding;
+    }
+
+    // bone data as uploaded to the vertex buffer, GetBoneEncoding().GetStride() bytes per vertex
+    const std::vector<unsigned char>& GetPackedBoneData() const
+    {
+        return m_packedBoneData;
+    }
+
+    // ranges of the influence buckets, indexed by bucket, empty buckets have no vertices
+    const InfluenceRange& GetInfluenceRange(unsigned int i_bucket) const
+    {
+        return m_influenceRanges[i_bucket];
+    }
+
+    // bind the textures to consecutive units and point the samplers at them
+    void BindTextures(const Shader& i_shader) const;
+
   private:
-    unsigned int m_VAO = 0;
-    unsigned int m_EBO = 0;
-    unsigned int m_vertexData_vbo = 0;
-    unsigned int m_vertexBones_vbo = 0;
+    // put all vertices and triangles into the highest bucket, which is right for any vertex
+    void resetInfluenceRanges();
+
+    // encode m_vertexBoneData into m_packedBoneData
+    void packBoneData();
+
+    // create the feedback buffer and the VAO drawing from it
+    void initializeFeedbackBuffer();
+
+    GpuResource m_VAO;
+    GpuResource m_EBO;
+    GpuResource m_vertexData_vbo;
+    GpuResource m_vertexBones_vbo;
+    // skinned vertices of the last SkinToFeedback, drawn through m_skinnedVAO
+    GpuResource m_feedback_vbo;
+    GpuResource m_skinnedVAO;
 
     std::vector<Vertex> m_vertices;
     std::vector<unsigned int> m_indices;
     std::vector<Texture> m_textures;
     std::vector<BoneInfo> m_bones;
     std::vector<VertexBoneData> m_vertexBoneData;
+    BoneEncoding m_boneEncoding;
+    std::vector<unsigned char> m_packedBoneData;
+    // everything in the 8 influence bucket until PartitionInfluences
+    InfluenceRange m_influenceRanges[NUM_INFLUENCE_BUCKETS];
 };
\ No newline at end of file
@@ -1,3 +1,5 @@
+#pragma once
+
 #include <GL/glew.h>
 #include <glm.hpp>
 #include <gtc/matrix_transform.hpp>
@@ -5,12 +7,98 @@
 #include <gtx/quaternion.hpp>
 #include <gtx/dual_quaternion.hpp>
 
+#include <cstring>
 #include <string>
+#include <vector>
 
-#define NUM_BONES_PER_VERTEX 4
+// Most influences a vertex keeps. Vertices are bucketed by how many they actually use, see
+// GetInfluenceBucket, so rigid vertices do not pay for eight.
+#define NUM_BONES_PER_VERTEX 8
+#define NUM_INFLUENCE_BUCKETS 4
 #define ZERO_MEM(a) memset(a, 0, sizeof(a))
 #define ARRAY_SIZE_IN_ELEMENTS(a) (sizeof(a)/sizeof(a[0]))
 #define INVALID_MATERIAL 0xFFFFFFFF
+//------------------------------------------------------
+// SKINNING MODE
+//------------------------------------------------------
+
+// Mirrors the lbsOn / dqsOn / ratio uniforms of the vertex shader
+enum class SkinningMode
+{
+	LBS,
+	DQS,
+	// (1 - ratio) * LBS + ratio * DQS, needs both palettes
+	Hybrid
+};
+
+inline SkinningMode GetSkinningMode(bool i_lbsOn, bool i_dqsOn)
+{
+	if (i_lbsOn)
+	{
+		return SkinningMode::LBS;
+	}
+	return i_dqsOn ? SkinningMode::DQS : SkinningMode::Hybrid;
+}
+
+// Hybrid with ratio 0 or 1 is plain LBS or DQS, the cheaper variant gives the same result
+inline SkinningMode GetSkinningVariant(SkinningMode i_mode, float i_ratio)
+{
+	if (i_mode == SkinningMode::Hybrid && i_ratio <= 0.0f)
+	{
+		return SkinningMode::LBS;
+	}
+	if (i_mode == SkinningMode::Hybrid && i_ratio >= 1.0f)
+	{
+		return SkinningMode::DQS;
+	}
+	return i_mode;
+}
+
+// #define selecting the method in the skinning shaders, see ShaderDefines
+inline const char* GetSkinningDefine(SkinningMode i_mode)
+{
+	switch (i_mode)
+	{
+	case SkinningMode::LBS:
+		return "SKINNING_LBS";
+	case SkinningMode::DQS:
+		return "SKINNING_DQS";
+	default:
+		return "SKINNING_HYBRID";
+	}
+}
+
+//------------------------------------------------------
+// INFLUENCE BUCKETS
+//------------------------------------------------------
+
+// influences the skinning code reads for a bucket: 1, 2, 4 or 8
+inline unsigned int GetBucketInfluences(unsigned int i_bucket)
+{
+	return 1u << i_bucket;
+}
+
+// smallest bucket holding i_numInfluences influences
+inline unsigned int GetInfluenceBucket(unsigned int i_numInfluences)
+{
+	unsigned int bucket = 0;
+	while (bucket + 1 < NUM_INFLUENCE_BUCKETS && GetBucketInfluences(bucket) < i_numInfluences)
+	{
+		++bucket;
+	}
+	return bucket;
+}
+
+// vertices and triangles of a mesh in one bucket. The vertices use at most the bucket's
+// influences, the triangles have no vertex in a higher bucket.
+struct InfluenceRange
+{
+	unsigned int firstVertex = 0;
+	unsigned int numVertices = 0;
+	unsigned int firstIndex = 0;
+	unsigned int numIndices = 0;
+};
+
 //------------------------------------------------------
 // VERTEX
 //------------------------------------------------------
@@ -29,6 +117,20 @@ struct Vertex
 	glm::vec3 Bitangent;
 };
 
+//------------------------------------------------------
+// SKINNED VERTEX
+//------------------------------------------------------
+
+// Vertex skinned on the GPU, drawn by res/shaders/skinned.vs. Transform feedback captures the
+// FragPos, Normal and TexCoord outputs of the skinning shader in this layout, the compute
+// skinning shader writes it directly.
+struct SkinnedVertex
+{
+	glm::vec3 Position;
+	glm::vec3 Normal;
+	glm::vec2 TexCoords;
+};
+
 //------------------------------------------------------
 // TEXTURE
 //------------------------------------------------------
@@ -115,7 +217,174 @@ struct VertexBoneData
 		}
 	}
 
+	// influences are filled front to back, so the used ones are the leading non-zero weights
+	unsigned int GetNumInfluences() const
+	{
+		unsigned int count = 0;
+		while (count < NUM_BONES_PER_VERTEX && Weights[count] != 0.0f)
+		{
+			++count;
+		}
+		return count;
+	}
+
 	//vertex bone data
 	unsigned int BoneIDs[NUM_BONES_PER_VERTEX];
 	float Weights[NUM_BONES_PER_VERTEX];
-};
\ No newline at end of file
+};
+
+//------------------------------------------------------
+// BONE ENCODING
+//------------------------------------------------------
+
+// Layout of the bone indices and weights in the vertex buffers: NUM_BONES_PER_VERTEX indices,
+// 8-bit for skeletons of up to 256 bones and 16-bit above, followed by NUM_BONES_PER_VERTEX
+// unorm8 or unorm16 weights. Only the first NUM_BONES_PER_VERTEX - 1 weights are stored, the
+// last slot is padding: the last influence a draw reads weighs what the others leave of 1. This
+// needs weights summing to one, which Model ensures.
+struct BoneEncoding
+{
+	// 16-bit indices instead of 8-bit
+	bool wideIndices = false;
+	// unorm16 weights instead of unorm8
+	bool wideWeights = false;
+
+	unsigned int GetIndexSize() const
+	{
+		return wideIndices ? 2 : 1;
+	}
+
+	unsigned int GetWeightSize() const
+	{
+		return wideWeights ? 2 : 1;
+	}
+
+	// offset of the weights in a vertex
+	unsigned int GetWeightsOffset() const
+	{
+		return NUM_BONES_PER_VERTEX * GetIndexSize();
+	}
+
+	// bytes per vertex: 16 for 8-bit indices and unorm8 weights, 32 for 16-bit and unorm16
+	unsigned int GetStride() const
+	{
+		return NUM_BONES_PER_VERTEX * (GetIndexSize() + GetWeightSize());
+	}
+
+	GLenum GetIndexType() const
+	{
+		return wideIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE;
+	}
+
+	GLenum GetWeightType() const
+	{
+		return wideWeights ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE;
+	}
+
+	unsigned int GetMaxWeight() const
+	{
+		return wideWeights ? 0xFFFF : 0xFF;
+	}
+};
+
+// smallest indices for the skeleton, the weights only widen on request
+inline BoneEncoding GetBoneEncoding(unsigned int i_numBones, bool i_wideWeights = false)
+{
+	BoneEncoding encoding;
+	encoding.wideIndices = i_numBones > 256;
+	encoding.wideWeights = i_wideWeights;
+	return encoding;
+}
+
+// Quantize the weights of a vertex to [0, i_maxWeight]. The running sum is rounded instead of
+// every weight, so the stored weights never add up to more than i_maxWeight and the implied last
+// weight stays the rounded remainder, whichever influence count a draw reads.
+inline void QuantizeWeights(const VertexBoneData& i_boneData, unsigned int i_maxWeight,
+                            unsigned int o_weights[NUM_BONES_PER_VERTEX])
+{
+	float sum = 0.0f;
+	unsigned int previous = 0;
+	for (unsigned int i = 0; i < NUM_BONES_PER_VERTEX; ++i)
+	{
+		sum += i_boneData.Weights[i];
+		unsigned int total = static_cast<unsigned int>(sum * i_maxWeight + 0.5f);
+		total = total < i_maxWeight ? total : i_maxWeight;
+		o_weights[i] = total > previous ? total - previous : 0;
+		previous = total > previous ? total : previous;
+	}
+}
+
+// append the encoded bone data of the vertices
+inline void EncodeBoneData(const std::vector<VertexBoneData>& i_boneData,
+                           const BoneEncoding& i_encoding, std::vector<unsigned char>& io_bytes)
+{
+	const unsigned int stride = i_encoding.GetStride();
+	const size_t first = io_bytes.size();
+	io_bytes.resize(first + i_boneData.size() * stride, 0);
+
+	for (size_t v = 0; v < i_boneData.size(); ++v)
+	{
+		unsigned char* vertex = &io_bytes[first + v * stride];
+		unsigned int weights[NUM_BONES_PER_VERTEX];
+		QuantizeWeights(i_boneData[v], i_encoding.GetMaxWeight(), weights);
+
+		for (unsigned int i = 0; i < NUM_BONES_PER_VERTEX; ++i)
+		{
+			const unsigned int boneID = i_boneData[v].BoneIDs[i];
+			if (i_encoding.wideIndices)
+			{
+				const unsigned short index = static_cast<unsigned short>(boneID);
+				memcpy(vertex + 2 * i, &index, sizeof(index));
+			}
+			else
+			{
+				vertex[i] = static_cast<unsigned char>(boneID);
+			}
+
+			// the last slot is implied
+			if (i + 1 == NUM_BONES_PER_VERTEX)
+			{
+				continue;
+			}
+			unsigned char* weight = vertex + i_encoding.GetWeightsOffset();
+			if (i_encoding.wideWeights)
+			{
+				const unsigned short value = static_cast<unsigned short>(weights[i]);
+				memcpy(weight + 2 * i, &value, sizeof(value));
+			}
+			else
+			{
+				weight[i] = static_cast<unsigned char>(weights[i]);
+			}
+		}
+	}
+}
+
+// the bone data a draw reads back from an encoded vertex, with the last slot holding the implied
+// weight. Lets the CPU reference skin exactly what the GPU sees.
+inline VertexBoneData DecodeBoneData(const unsigned char* i_vertex, const BoneEncoding& i_encoding)
+{
+	VertexBoneData boneData;
+	const unsigned char* weights = i_vertex + i_encoding.GetWeightsOffset();
+	float remaining = 1.0f;
+	for (unsigned int i = 0; i < NUM_BONES_PER_VERTEX; ++i)
+	{
+		unsigned short index = i_vertex[i];
+		unsigned short weight = weights[i];
+		if (i_encoding.wideIndices)
+		{
+			memcpy(&index, i_vertex + 2 * i, sizeof(index));
+		}
+		if (i_encoding.wideWeights)
+		{
+			memcpy(&weight, weights + 2 * i, sizeof(weight));
+		}
+
+		boneData.BoneIDs[i] = index;
+		boneData.Weights[i] = i + 1 == NUM_BONES_PER_VERTEX
+		                          ? remaining
+		                          : weight / static_cast<float>(i_encoding.GetMaxWeight());
+		remaining -= boneData.Weights[i];
+	}
+	return boneData;
+}
@@ -1,26 +1,16 @@
 #include "Model.h"
 #include "Log.h"
 
+#include <algorithm>
 #include <assimp/Importer.hpp>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
-namespace
-{
-glm::fdualquat MakeDualQuat(const glm::fquat& rotation, const glm::vec3& translation)
-{
-    glm::fdualquat dq;
-    dq.real = rotation;
-    glm::fquat translationQuat(0.0f, translation.x, translation.y, translation.z);
-    dq.dual = 0.5f * translationQuat * rotation;
-    return dq;
-}
-} // namespace
-
 //----------------------------------------------------------------
 
-Model::Model(const std::string& i_path)
+Model::Model(const std::string& i_path, const InfluenceSettings& i_influences)
+    : m_influenceSettings(i_influences)
 {
     // Retrieve the directory path of the filepath
     m_directory = i_path.substr(0, i_path.find_last_of('/'));
@@ -29,6 +19,12 @@ Model::Model(const std::string& i_path)
     loadModel(i_path);
 
     std::cout << "[Model] Bones detected: " << m_NumBones << std::endl;
+    std::cout << "[Model] Kept " << m_influenceReport.numInfluences << " of "
+              << m_influenceReport.numSourceInfluences << " influences of "
+              << m_influenceReport.numVertices << " vertices (" << m_influenceReport.numPruned
+              << " pruned, " << m_influenceReport.numTruncated << " truncated, "
+              << m_influenceReport.numUnweighted << " unweighted, up to "
+              << m_influenceReport.maxSourceInfluences << " per vertex in the file)" << std::endl;
 }
 
 //----------------------------------------------------------------
@@ -51,38 +47,63 @@ void Model::Draw(const Shader& i_shader)
 
 //----------------------------------------------------------------
 
-void Model::BoneTransform(const float& i_timeInSeconds, std::vector<glm::mat4>& io_transforms,
-                          std::vector<glm::fdualquat>& io_dqs)
+void Model::SkinToFeedback()
 {
-    if (!m_scene->HasAnimations())
+    glEnable(GL_RASTERIZER_DISCARD);
+    for (Mesh& mesh : m_meshes)
     {
-        return;
+        mesh.SkinToFeedback();
     }
+    glDisable(GL_RASTERIZER_DISCARD);
+}
 
-    glm::mat4 Identity = glm::mat4(1.0f);
-    unsigned int numPosKeys = m_scene->mAnimations[0]->mChannels[0]->mNumPositionKeys;
+//----------------------------------------------------------------
 
-    float TicksPerSecond = m_scene->mAnimations[0]->mTicksPerSecond != 0
-                               ? m_scene->mAnimations[0]->mTicksPerSecond
-                               : 25.0f;
+void Model::UploadSkinned(unsigned int i_mesh, const SkinnedVertex* i_vertices)
+{
+    m_meshes[i_mesh].UploadSkinned(i_vertices);
+}
+
+//----------------------------------------------------------------
 
-    float TimeInTicks = i_timeInSeconds * TicksPerSecond;
-    float AnimationTime = fmod(
-        TimeInTicks, m_scene->mAnimations[0]->mChannels[0]->mPositionKeys[numPosKeys - 1].mTime);
+void Model::DrawSkinned(const Shader& i_shader)
+{
+    for (Mesh& mesh : m_meshes)
+    {
+        mesh.DrawSkinned(i_shader);
+    }
+}
 
-    ReadNodeHeirarchy(AnimationTime, m_scene->mRootNode, Identity, IdentityDQ,
-                      glm::vec3(0.0f, 0.0f, 0.0f));
+//----------------------------------------------------------------
 
+void Model::BoneTransform(const float& i_timeInSeconds, std::vector<glm::mat4>& io_transforms,
+                          std::vector<glm::fdualquat>& io_dqs)
+{
+    BoneTransform(i_timeInSeconds, SkinningMode::Hybrid, io_transforms, io_dqs);
+}
+
+//----------------------------------------------------------------
+
+void Model::BoneTransform(const float& i_timeInSeconds, SkinningMode i_mode,
+                          std::vector<glm::mat4>& io_transforms,
+                          std::vector<glm::fdualquat>& io_dqs)
+{
+    if (!updatePose(i_timeInSeconds, i_mode))
+    {
+        return;
+    }
+
+    // only the palette of the active skinning method is written
     io_transforms.resize(m_NumBones);
     io_dqs.resize(m_NumBones);
 
-    for (unsigned int i = 0; i < m_NumBones; ++i)
+    for (unsigned int i = 0; i < m_NumBones && i_mode != SkinningMode::DQS; ++i)
     {
         io_transforms[i] = glm::mat4(1.0f);
         io_transforms[i] = m_BoneInfo[i].FinalTransformation;
     }
 
-    for (unsigned int i = 0; i < io_dqs.size(); ++i)
+    for (unsigned int i = 0; i < io_dqs.size() && i_mode != SkinningMode::LBS; ++i)
     {
         io_dqs[i] = IdentityDQ;
         io_dqs[i] = m_BoneInfo[i].FinalTransDQ;
@@ -95,6 +116,71 @@ void Model::BoneTransform(const float& i_timeInSeconds, std::vector<glm::mat4>&
 
 //----------------------------------------------------------------
 
+void Model::BoneTransform(const float& i_timeInSeconds, SkinningMode i_mode,
+                          glm::mat3x4* o_transforms, glm::mat2x4* o_dqs)
+{
+    updatePose(i_timeInSeconds, i_mode);
+
+    // plain stores in bone order, the destination may be write-combined mapped memory
+    for (unsigned int i = 0; i < m_NumBones && i_mode != SkinningMode::DQS; ++i)
+    {
+        o_transforms[i] = convertMatrix(m_BoneInfo[i].FinalTransformation);
+    }
+
+    for (unsigned int i = 0; i < m_NumBones && i_mode != SkinningMode::LBS; ++i)
+    {
+        o_dqs[i] = glm::mat2x4_cast(m_BoneInfo[i].FinalTransDQ);
+    }
+}
+
+//----------------------------------------------------------------
+
+bool Model::updatePose(float i_timeInSeconds, SkinningMode i_mode)
+{
+    if (m_clips.empty())
+    {
+        return false;
+    }
+
+    samplePlayback(i_timeInSeconds, m_playback, m_pose);
+
+    // blend the local poses, the hierarchy is still evaluated only once
+    if (m_fading)
+    {
+        if (m_fadeStart < 0.0f)
+        {
+            m_fadeStart = i_timeInSeconds;
+        }
+
+        samplePlayback(i_timeInSeconds, m_fadeTarget, m_fadePose);
+
+        float weight = m_fadeDuration > 0.0f
+                           ? (i_timeInSeconds - m_fadeStart) / m_fadeDuration
+                           : 1.0f;
+        if (weight >= 1.0f)
+        {
+            // the target clip is fully faded in and becomes the played clip
+            std::swap(m_playback, m_fadeTarget);
+            std::swap(m_pose, m_fadePose);
+            m_fading = false;
+        }
+        else
+        {
+            m_rig.BlendPose(m_fadePose, std::max(weight, 0.0f), m_pose);
+        }
+    }
+
+    for (AnimationLayer& layer : m_layers)
+    {
+        applyLayer(i_timeInSeconds, layer, m_pose);
+    }
+
+    EvaluateRig(m_pose, i_mode);
+    return true;
+}
+
+//----------------------------------------------------------------
+
 void Model::loadModel(const std::string& i_path)
 {
     Assimp::Importer importer;
@@ -117,6 +203,325 @@ void Model::loadModel(const std::string& i_path)
 
     // Load mesh from nodes recursively
     processNode(m_scene->mRootNode);
+
+    // Flatten the hierarchy once the animation channels are known
+    buildRig();
+}
+
+//----------------------------------------------------------------
+
+void Model::buildRig()
+{
+    m_rig.Build(m_scene->mRootNode, Bone_Mapping);
+
+    m_globalTransforms.resize(m_rig.GetNumNodes());
+    m_globalDQs.resize(m_rig.GetNumNodes());
+
+    // compile every animation once, sampling never touches the aiScene afterwards
+    m_clips.clear();
+    for (unsigned int i = 0; i < m_scene->mNumAnimations; ++i)
+    {
+        const aiAnimation* pAnimation = m_scene->mAnimations[i];
+        const nodeAnimationMap& channels = Animations[pAnimation->mName.data];
+        m_clips.push_back(std::make_shared<const AnimationClip>(pAnimation, channels, m_rig));
+    }
+
+    m_rig.InitPose(m_pose);
+    m_rig.InitPose(m_fadePose);
+
+    foldStaticNodes();
+
+    if (!m_clips.empty())
+    {
+        // the first clip plays from application time 0
+        startPlayback(0, m_playback);
+        m_playback.startTime = 0.0f;
+    }
+}
+
+//----------------------------------------------------------------
+
+int Model::FindClip(const std::string& i_name) const
+{
+    for (unsigned int i = 0; i < m_clips.size(); ++i)
+    {
+        if (m_clips[i]->GetName() == i_name)
+        {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+//----------------------------------------------------------------
+
+bool Model::PlayClip(unsigned int i_clip)
+{
+    if (i_clip >= m_clips.size())
+    {
+        return false;
+    }
+
+    startPlayback(i_clip, m_playback);
+    m_fading = false;
+    return true;
+}
+
+//----------------------------------------------------------------
+
+bool Model::PlayClip(const std::string& i_name)
+{
+    int clip = FindClip(i_name);
+    return clip >= 0 && PlayClip(static_cast<unsigned int>(clip));
+}
+
+//----------------------------------------------------------------
+
+bool Model::CrossfadeTo(unsigned int i_clip, float i_duration)
+{
+    if (i_clip >= m_clips.size())
+    {
+        return false;
+    }
+
+    if (m_fading)
+    {
+        std::swap(m_playback, m_fadeTarget);
+    }
+
+    startPlayback(i_clip, m_fadeTarget);
+    m_fading = true;
+    m_fadeStart = -1.0f;
+    m_fadeDuration = i_duration;
+    return true;
+}
+
+//----------------------------------------------------------------
+
+bool Model::CrossfadeTo(const std::string& i_name, float i_duration)
+{
+    int clip = FindClip(i_name);
+    return clip >= 0 && CrossfadeTo(static_cast<unsigned int>(clip), i_duration);
+}
+
+//----------------------------------------------------------------
+
+void Model::startPlayback(unsigned int i_clip, ClipPlayback& o_playback)
+{
+    o_playback.clip = i_clip;
+    o_playback.startTime = -1.0f;
+    o_playback.cursors.assign(m_clips[i_clip]->GetNumChannels(), KeyCursor());
+}
+
+//----------------------------------------------------------------
+
+float Model::playbackTime(float i_timeInSeconds, ClipPlayback& io_playback)
+{
+    const AnimationClip& clip = *m_clips[io_playback.clip];
+
+    if (io_playback.startTime < 0.0f)
+    {
+        io_playback.startTime = i_timeInSeconds;
+    }
+
+    float TimeInTicks = (i_timeInSeconds - io_playback.startTime) * clip.GetTicksPerSecond();
+    float Duration = clip.GetDuration();
+    float AnimationTime = Duration > 0.0f ? fmod(TimeInTicks, Duration) : 0.0f;
+    if (AnimationTime < 0.0f)
+    {
+        AnimationTime += Duration;
+    }
+    return AnimationTime;
+}
+
+//----------------------------------------------------------------
+
+void Model::samplePlayback(float i_timeInSeconds, ClipPlayback& io_playback, Pose& o_pose)
+{
+    float AnimationTime = playbackTime(i_timeInSeconds, io_playback);
+    m_clips[io_playback.clip]->SamplePose(AnimationTime, io_playback.cursors, o_pose);
+}
+
+//----------------------------------------------------------------
+
+int Model::AddAdditiveClip(unsigned int i_source, unsigned int i_reference,
+                           float i_referenceTime)
+{
+    if (i_source >= m_clips.size() || i_reference >= m_clips.size())
+    {
+        std::cout << "[Model] Additive clip from unknown clip " << i_source << " or "
+                  << i_reference << std::endl;
+        return -1;
+    }
+
+    if (m_clips[i_source]->IsResampled())
+    {
+        std::cout << "[Model] Additive clips have to be built from the source keys" << std::endl;
+        return -1;
+    }
+
+    // nodes the reference clip does not animate are measured against the bind pose
+    Pose reference;
+    m_rig.InitPose(reference);
+    std::vector<KeyCursor> cursors(m_clips[i_reference]->GetNumChannels());
+    m_clips[i_reference]->SamplePose(i_referenceTime, cursors, reference);
+
+    std::shared_ptr<AnimationClip> clip = std::make_shared<AnimationClip>(*m_clips[i_source]);
+    clip->MakeAdditive(reference);
+    m_clips.push_back(clip);
+    foldStaticNodes();
+    return static_cast<int>(m_clips.size()) - 1;
+}
+
+//----------------------------------------------------------------
+
+int Model::AddLayer(unsigned int i_clip, float i_weight)
+{
+    if (i_clip >= m_clips.size())
+    {
+        std::cout << "[Model] Cannot add a layer playing unknown clip " << i_clip << std::endl;
+        return -1;
+    }
+
+    AnimationLayer layer;
+    startPlayback(i_clip, layer.playback);
+    layer.weight = i_weight;
+    layer.boneMask.assign(m_NumBones, 1.0f);
+    buildLayerChannels(layer);
+
+    m_layers.push_back(layer);
+    return static_cast<int>(m_layers.size()) - 1;
+}
+
+//----------------------------------------------------------------
+
+bool Model::SetLayerMask(unsigned int i_layer, const std::vector<float>& i_boneWeights)
+{
+    if (i_layer >= m_layers.size())
+    {
+        std::cout << "[Model] Cannot set the mask of unknown layer " << i_layer << std::endl;
+        return false;
+    }
+
+    m_layers[i_layer].boneMask = i_boneWeights;
+    buildLayerChannels(m_layers[i_layer]);
+    return true;
+}
+
+//----------------------------------------------------------------
+
+bool Model::SetLayerWeight(unsigned int i_layer, float i_weight)
+{
+    if (i_layer >= m_layers.size())
+    {
+        std::cout << "[Model] Cannot set the weight of unknown layer " << i_layer << std::endl;
+        return false;
+    }
+
+    m_layers[i_layer].weight = i_weight;
+    return true;
+}
+
+//----------------------------------------------------------------
+
+std::vector<float> Model::MakeBoneMask(const std::string& i_rootBone) const
+{
+    std::vector<float> mask(m_NumBones, 0.0f);
+    const std::vector<RigNode>& nodes = m_rig.GetNodes();
+
+    // parents come first, so a node is below the root once its parent is
+    std::vector<unsigned char> below(nodes.size(), 0);
+    for (unsigned int i = 0; i < nodes.size(); ++i)
+    {
+        below[i] = nodes[i].name == i_rootBone ||
+                   (nodes[i].parent != RigNode::NO_PARENT && below[nodes[i].parent]);
+        if (below[i] && nodes[i].boneIndex != RigNode::NO_BONE)
+        {
+            mask[nodes[i].boneIndex] = 1.0f;
+        }
+    }
+    return mask;
+}
+
+//----------------------------------------------------------------
+
+void Model::buildLayerChannels(AnimationLayer& io_layer)
+{
+    const AnimationClip& clip = *m_clips[io_layer.playback.clip];
+    const std::vector<RigNode>& nodes = m_rig.GetNodes();
+
+    io_layer.channels.clear();
+    for (unsigned int c = 0; c < clip.GetNumChannels(); ++c)
+    {
+        const unsigned int node = clip.GetChannel(c).node;
+        const int bone = nodes[node].boneIndex;
+        if (bone == RigNode::NO_BONE || bone >= (int)io_layer.boneMask.size() ||
+            io_layer.boneMask[bone] <= 0.0f)
+        {
+            continue;
+        }
+
+        LayerChannel channel;
+        channel.channel = c;
+        channel.node = node;
+        channel.weight = io_layer.boneMask[bone];
+        io_layer.channels.push_back(channel);
+    }
+}
+
+//----------------------------------------------------------------
+
+void Model::applyLayer(float i_timeInSeconds, AnimationLayer& io_layer, Pose& io_pose)
+{
+    if (io_layer.weight <= 0.0f || io_layer.channels.empty())
+    {
+        return;
+    }
+
+    const AnimationClip& clip = *m_clips[io_layer.playback.clip];
+    const std::vector<RigNode>& nodes = m_rig.GetNodes();
+    const float AnimationTime = playbackTime(i_timeInSeconds, io_layer.playback);
+    const glm::quat Identity(1.0f, 0.0f, 0.0f, 0.0f);
+
+    for (const LayerChannel& layerChannel : io_layer.channels)
+    {
+        const unsigned int node = layerChannel.node;
+        const float weight = io_layer.weight * layerChannel.weight;
+
+        glm::quat rotation;
+        glm::vec3 translation;
+        clip.SampleChannel(layerChannel.channel, AnimationTime,
+                           io_layer.playback.cursors[layerChannel.channel], rotation,
+                           translation);
+
+        const glm::quat baseRotation =
+            io_pose.animated[node] ? io_pose.rotations[node] : nodes[node].bindRotation;
+        const glm::vec3 baseTranslation =
+            io_pose.animated[node] ? io_pose.translations[node] : nodes[node].bindTranslation;
+
+        if (clip.IsAdditive())
+        {
+            // scale the delta down from the identity and apply it in local space
+            if (rotation.w < 0.0f)
+            {
+                rotation = -rotation;
+            }
+            glm::quat delta = glm::normalize(Identity * (1.0f - weight) + rotation * weight);
+            io_pose.rotations[node] = baseRotation * delta;
+            io_pose.translations[node] = baseTranslation + weight * translation;
+        }
+        else
+        {
+            if (glm::dot(baseRotation, rotation) < 0.0f)
+            {
+                rotation = -rotation;
+            }
+            io_pose.rotations[node] =
+                glm::normalize(baseRotation * (1.0f - weight) + rotation * weight);
+            io_pose.translations[node] = glm::mix(baseTranslation, translation, weight);
+        }
+        io_pose.animated[node] = 1;
+    }
 }
 
 //----------------------------------------------------------------
@@ -243,7 +648,21 @@ void Model::processMesh(aiMesh* aiMesh)
     mesh.SetTexture(textures);
     mesh.SetBoneInfo(m_BoneInfo);
     mesh.SetVertexBoneData(bones);
-    m_meshes.push_back(mesh);
+    mesh.PartitionInfluences();
+    // the bones are all known, loadBones runs first
+    mesh.SetBoneEncoding(GetBoneEncoding(m_NumBones));
+
+    std::cout << "[Model] Mesh " << m_meshes.size() << " vertices per influence bucket";
+    for (unsigned int b = 0; b < NUM_INFLUENCE_BUCKETS; ++b)
+    {
+        std::cout << " " << GetBucketInfluences(b) << ": "
+                  << mesh.GetInfluenceRange(b).numVertices;
+    }
+    std::cout << std::endl;
+
+    // upload once, drawing only binds the mesh's VAO
+    mesh.InitializeBuffer();
+    m_meshes.push_back(std::move(mesh));
 }
 
 //----------------------------------------------------------------
@@ -272,7 +691,9 @@ std::vector<Texture> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType
         if (!skip)
         { // if texture hasn't been loaded already, load it
             Texture texture;
-            texture.id = TextureFromFile(str.C_Str(), m_directory);
+            GpuResource textureObject = TextureFromFile(str.C_Str(), m_directory);
+            texture.id = textureObject.Get();
+            m_textureObjects.push_back(std::move(textureObject));
             texture.type = typeName;
             texture.path = str.C_Str();
             textures.push_back(texture);
@@ -288,6 +709,8 @@ std::vector<Texture> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType
 
 void Model::loadMeshBones(aiMesh* i_aiMesh, std::vector<VertexBoneData>& vertexBoneData)
 {
+    // every weight of every vertex, buildInfluences picks the ones to keep
+    std::vector<std::vector<BoneWeight>> weights(vertexBoneData.size());
     for (unsigned int i = 0; i < i_aiMesh->mNumBones; i++)
     {
         unsigned int BoneIndex = 0;
@@ -311,28 +734,73 @@ void Model::loadMeshBones(aiMesh* i_aiMesh, std::vector<VertexBoneData>& vertexB
         for (unsigned int n = 0; n < i_aiMesh->mBones[i]->mNumWeights; n++)
         {
             unsigned int vid = i_aiMesh->mBones[i]->mWeights[n].mVertexId;
-            float weight = i_aiMesh->mBones[i]->mWeights[n].mWeight;
-            vertexBoneData[vid].AddBoneData(BoneIndex, weight);
+            BoneWeight boneWeight;
+            boneWeight.boneIndex = BoneIndex;
+            boneWeight.weight = i_aiMesh->mBones[i]->mWeights[n].mWeight;
+            weights[vid].push_back(boneWeight);
         }
         loadAnimations(BoneName, Animations);
     }
 
-    // Normalize bone weights per vertex to ensure proper blending (especially for DQS).
-    for (VertexBoneData& vertex : vertexBoneData)
+    for (unsigned int v = 0; v < vertexBoneData.size(); ++v)
     {
-        float totalWeight = 0.0f;
-        for (unsigned int j = 0; j < NUM_BONES_PER_VERTEX; ++j)
-        {
-            totalWeight += vertex.Weights[j];
-        }
+        buildInfluences(weights[v], vertexBoneData[v]);
+    }
+}
 
-        if (totalWeight > 0.0f)
-        {
-            for (unsigned int j = 0; j < NUM_BONES_PER_VERTEX; ++j)
-            {
-                vertex.Weights[j] /= totalWeight;
-            }
-        }
+//----------------------------------------------------------------
+
+void Model::buildInfluences(std::vector<BoneWeight>& io_weights, VertexBoneData& o_boneData)
+{
+    InfluenceReport& report = m_influenceReport;
+    ++report.numVertices;
+    report.numSourceInfluences += static_cast<unsigned int>(io_weights.size());
+    report.maxSourceInfluences =
+        std::max(report.maxSourceInfluences, static_cast<unsigned int>(io_weights.size()));
+
+    o_boneData.Reset();
+    float total = 0.0f;
+    for (const BoneWeight& boneWeight : io_weights)
+    {
+        total += boneWeight.weight;
+    }
+    if (total <= 0.0f)
+    {
+        ++report.numUnweighted;
+        return;
+    }
+
+    // largest first, the first influence is also the hemisphere the dual quaternions blend in
+    std::sort(io_weights.begin(), io_weights.end(),
+              [](const BoneWeight& i_a, const BoneWeight& i_b) {
+                  return i_a.weight > i_b.weight ||
+                         (i_a.weight == i_b.weight && i_a.boneIndex < i_b.boneIndex);
+              });
+
+    // the largest weight always stays, however small
+    const unsigned int maxInfluences = std::max(
+        1u, std::min<unsigned int>(m_influenceSettings.maxInfluences, NUM_BONES_PER_VERTEX));
+    unsigned int numSignificant = 1;
+    while (numSignificant < io_weights.size() &&
+           io_weights[numSignificant].weight >= m_influenceSettings.minWeight * total)
+    {
+        ++numSignificant;
+    }
+    const unsigned int numKept = std::min(numSignificant, maxInfluences);
+
+    report.numPruned += numSignificant < io_weights.size() ? 1 : 0;
+    report.numTruncated += numSignificant > maxInfluences ? 1 : 0;
+    report.numInfluences += numKept;
+
+    float keptTotal = 0.0f;
+    for (unsigned int i = 0; i < numKept; ++i)
+    {
+        keptTotal += io_weights[i].weight;
+    }
+    for (unsigned int i = 0; i < numKept; ++i)
+    {
+        o_boneData.BoneIDs[i] = io_weights[i].boneIndex;
+        o_boneData.Weights[i] = io_weights[i].weight / keptTotal;
     }
 }
 
@@ -358,209 +826,290 @@ void Model::loadAnimations(const std::string& BoneName, AnimationMap& o_animatio
 
 //----------------------------------------------------------------
 
-void Model::ReadNodeHeirarchy(float AnimationTime, const aiNode* pNode,
-                              const glm::mat4& ParentTransform, const glm::fdualquat& ParentDQ,
-                              glm::vec3 startpos)
+bool Model::ShareAnimations(const Model& i_source)
 {
-    std::string NodeName(pNode->mName.data);
-    const aiAnimation* pAnimation = m_scene->mAnimations[0];
-    glm::mat4 NodeTransformation = glm::mat4(1.0f);
-    aiMatrix4x4 tp1 = pNode->mTransformation;
-    NodeTransformation = glm::transpose(glm::make_mat4(&tp1.a1));
-
-    const aiNodeAnim* pNodeAnim = nullptr;
-    pNodeAnim = Animations[pAnimation->mName.data][NodeName];
-
-    if (pNodeAnim)
-    {
-
-        // Interpolate rotation and generate rotation transformation matrix
-        aiQuaternion RotationQ;
-        CalcInterpolatedRotaion(RotationQ, AnimationTime, pNodeAnim);
-
-        aiMatrix3x3 tp = RotationQ.GetMatrix();
-        glm::mat4 RotationM = glm::transpose(glm::make_mat3(&tp.a1));
-
-        // Interpolate translation and generate translation transformation matrix
-        aiVector3D Translation;
-        CalcInterpolatedPosition(Translation, AnimationTime, pNodeAnim);
-        glm::mat4 TranslationM = glm::mat4(1.0f);
-        TranslationM =
-            glm::translate(TranslationM, glm::vec3(Translation.x, Translation.y, Translation.z));
-
-        NodeTransformation = TranslationM * RotationM;
-    }
-
-    glm::mat4 GlobalTransformation = ParentTransform * NodeTransformation;
-    glm::fquat nodeRotation = glm::normalize(glm::quat_cast(NodeTransformation));
-    glm::vec3 nodeTranslation(NodeTransformation[3][0], NodeTransformation[3][1],
-                              NodeTransformation[3][2]);
-    glm::fdualquat NodeDQ = glm::normalize(MakeDualQuat(nodeRotation, nodeTranslation));
-    glm::fdualquat GlobalDQ = glm::normalize(ParentDQ * NodeDQ);
-
-    unsigned int ID = 0;
-
-    if (Bone_Mapping.find(NodeName) != Bone_Mapping.end())
+    if (!m_rig.IsCompatible(i_source.m_rig))
     {
-        startpos.x = GlobalTransformation[3][0];
-        startpos.y = GlobalTransformation[3][1];
-        startpos.z = GlobalTransformation[3][2];
-        ID = Bone_Mapping[NodeName];
-        skeleton_pose[ID] = startpos;
+        std::cout << "[Model] Cannot share animations, rigs do not match" << std::endl;
+        return false;
     }
 
-    if (Bone_Mapping.find(NodeName) != Bone_Mapping.end())
-    {
-        unsigned int NodeIndex = Bone_Mapping[NodeName];
-        m_BoneInfo[NodeIndex].FinalTransformation =
-            GlobalTransformation * m_BoneInfo[NodeIndex].offset;
-
-        glm::fdualquat finalDQ = glm::normalize(GlobalDQ * m_BoneInfo[NodeIndex].offsetDQ);
-        m_BoneInfo[NodeIndex].FinalTransDQ = finalDQ;
-    }
-    for (unsigned int i = 0; i < pNode->mNumChildren; i++)
+    m_clips = i_source.m_clips;
+    m_layers.clear();
+    m_fading = false;
+    foldStaticNodes();
+    if (!m_clips.empty())
     {
-        ReadNodeHeirarchy(AnimationTime, pNode->mChildren[i], GlobalTransformation, GlobalDQ,
-                          startpos);
+        startPlayback(0, m_playback);
+        m_playback.startTime = 0.0f;
     }
+    return true;
 }
 
 //----------------------------------------------------------------
 
-void Model::CalcInterpolatedScaling(aiVector3D& Out, float AnimationTime,
-                                    const aiNodeAnim* pNodeAnim)
+ClipReport Model::ResampleClip(unsigned int i_clip, float i_sampleRate)
 {
-    if (pNodeAnim->mNumScalingKeys == 1)
+    if (m_clips[i_clip]->IsCompressed())
     {
-        Out = pNodeAnim->mScalingKeys[0].mValue;
-        return;
+        std::cout << "[Model] Compressed clips cannot be resampled" << std::endl;
+        return ClipReport();
     }
 
-    unsigned int ScalingIndex = FindScaling(AnimationTime, pNodeAnim);
-    unsigned int NextScalingIndex = (ScalingIndex + 1);
-    assert(NextScalingIndex < pNodeAnim->mNumScalingKeys);
-    float DeltaTime = (float)(pNodeAnim->mScalingKeys[NextScalingIndex].mTime -
-                              pNodeAnim->mScalingKeys[ScalingIndex].mTime);
-    float Factor = (AnimationTime - (float)pNodeAnim->mScalingKeys[ScalingIndex].mTime) / DeltaTime;
-    assert(Factor >= 0.0f && Factor <= 1.0f);
-    const aiVector3D& Start = pNodeAnim->mScalingKeys[ScalingIndex].mValue;
-    const aiVector3D& End = pNodeAnim->mScalingKeys[NextScalingIndex].mValue;
-    aiVector3D Delta = End - Start;
-    Out = Start + Factor * Delta;
+    std::shared_ptr<AnimationClip> clip = std::make_shared<AnimationClip>(*m_clips[i_clip]);
+    ClipReport report = clip->Resample(i_sampleRate);
+    m_clips[i_clip] = clip;
+    return report;
 }
 
 //----------------------------------------------------------------
 
-void Model::CalcInterpolatedRotaion(aiQuaternion& Out, float AnimationTime,
-                                    const aiNodeAnim* pNodeAnim)
+ClipReport Model::CompressClip(unsigned int i_clip, float i_sampleRate)
 {
-    // we need at least two values to interpolate...
-    if (pNodeAnim->mNumRotationKeys == 1)
+    if (m_clips[i_clip]->IsCompressed())
     {
-        Out = pNodeAnim->mRotationKeys[0].mValue;
-        return;
+        std::cout << "[Model] Clip " << i_clip << " is already compressed" << std::endl;
+        return ClipReport();
     }
 
-    unsigned int RotationIndex = FindRotation(AnimationTime, pNodeAnim);
-    unsigned int NextRotationIndex = (RotationIndex + 1);
-    assert(NextRotationIndex < pNodeAnim->mNumRotationKeys);
-    float DeltaTime = (float)(pNodeAnim->mRotationKeys[NextRotationIndex].mTime -
-                              pNodeAnim->mRotationKeys[RotationIndex].mTime);
-    float Factor =
-        (AnimationTime - (float)pNodeAnim->mRotationKeys[RotationIndex].mTime) / DeltaTime;
-    assert(Factor >= 0.0f && Factor <= 1.0f);
-    const aiQuaternion& StartRotationQ = pNodeAnim->mRotationKeys[RotationIndex].mValue;
-    const aiQuaternion& EndRotationQ = pNodeAnim->mRotationKeys[NextRotationIndex].mValue;
-    aiQuaternion::Interpolate(Out, StartRotationQ, EndRotationQ, Factor);
-    Out = Out.Normalize(); // normalized
+    std::shared_ptr<AnimationClip> clip = std::make_shared<AnimationClip>(*m_clips[i_clip]);
+    ClipReport report = clip->Compress(i_sampleRate);
+    m_clips[i_clip] = clip;
+    return report;
 }
 
 //----------------------------------------------------------------
 
-void Model::CalcInterpolatedPosition(aiVector3D& Out, float AnimationTime,
-                                     const aiNodeAnim* pNodeAnim)
+void Model::EvaluateRig(const Pose& i_pose, SkinningMode i_mode)
 {
-    if (pNodeAnim->mNumPositionKeys == 1)
+    // parents are stored before their children, so their globals are always ready
+    for (unsigned int i : m_dynamicNodes)
     {
-        Out = pNodeAnim->mPositionKeys[0].mValue;
-        return;
+        evaluateNode(i, i_pose.animated[i] != 0, i_pose.rotations[i], i_pose.translations[i],
+                     i_mode);
     }
-
-    unsigned int PositionIndex = FindPosition(AnimationTime, pNodeAnim);
-    unsigned int NextPositionIndex = (PositionIndex + 1);
-    assert(NextPositionIndex < pNodeAnim->mNumPositionKeys);
-    float DeltaTime = (float)(pNodeAnim->mPositionKeys[NextPositionIndex].mTime -
-                              pNodeAnim->mPositionKeys[PositionIndex].mTime);
-    float Factor =
-        (AnimationTime - (float)pNodeAnim->mPositionKeys[PositionIndex].mTime) / DeltaTime;
-    assert(Factor >= 0.0f && Factor <= 1.0f);
-    const aiVector3D& Start = pNodeAnim->mPositionKeys[PositionIndex].mValue;
-    const aiVector3D& End = pNodeAnim->mPositionKeys[NextPositionIndex].mValue;
-    aiVector3D Delta = End - Start;
-    Out = Start + Factor * Delta;
 }
 
 //----------------------------------------------------------------
 
-unsigned int Model::FindScaling(float AnimationTime, const aiNodeAnim* pNodeAnim)
+void Model::evaluateNode(unsigned int i_node, bool i_animated, const glm::quat& i_rotation,
+                         const glm::vec3& i_translation, SkinningMode i_mode)
 {
-    assert(pNodeAnim->mNumScalingKeys > 0);
+    const RigNode& node = m_rig.GetNodes()[i_node];
+    const bool isRoot = node.parent == RigNode::NO_PARENT;
+    const int NodeIndex = node.boneIndex;
 
-    for (unsigned int i = 0; i < pNodeAnim->mNumScalingKeys - 1; i++)
+    // matrices feed linear blend skinning, dual quaternions feed DQS, the hybrid needs both
+    if (i_mode != SkinningMode::DQS)
     {
-        if (AnimationTime < (float)pNodeAnim->mScalingKeys[i + 1].mTime)
+        glm::mat4 NodeTransformation = node.bindLocal;
+        if (i_animated)
         {
-            return i;
+            // generate rotation and translation transformation matrices
+            glm::mat4 RotationM = glm::mat4_cast(i_rotation);
+            glm::mat4 TranslationM = glm::translate(glm::mat4(1.0f), i_translation);
+
+            NodeTransformation = TranslationM * RotationM;
         }
-    }
-    assert(0);
-    return 0;
-}
 
-//----------------------------------------------------------------
+        glm::mat4& GlobalTransformation = m_globalTransforms[i_node];
+        GlobalTransformation = isRoot ? NodeTransformation
+                                      : m_globalTransforms[node.parent] * NodeTransformation;
 
-unsigned int Model::FindRotation(float AnimationTime, const aiNodeAnim* pNodeAnim)
-{
-    assert(pNodeAnim->mNumRotationKeys > 0);
+        if (NodeIndex != RigNode::NO_BONE)
+        {
+            skeleton_pose[NodeIndex] = glm::vec3(GlobalTransformation[3][0],
+                                                 GlobalTransformation[3][1],
+                                                 GlobalTransformation[3][2]);
 
-    for (unsigned int i = 0; i < pNodeAnim->mNumRotationKeys - 1; i++)
+            m_BoneInfo[NodeIndex].FinalTransformation =
+                GlobalTransformation * m_BoneInfo[NodeIndex].offset;
+        }
+    }
+
+    if (i_mode != SkinningMode::LBS)
     {
-        if (AnimationTime < (float)pNodeAnim->mRotationKeys[i + 1].mTime)
+        glm::fdualquat NodeDQ = node.bindLocalDQ;
+        if (i_animated)
+        {
+            // compose the dual quaternion straight from the sampled rotation and translation, a
+            // unit rotation already gives a unit dual quaternion
+            NodeDQ = MakeDualQuat(glm::normalize(i_rotation), i_translation);
+
+#if VALIDATE_DUALQUAT
+            // legacy path: back to a quaternion through the matrix, normalized twice
+            glm::mat4 NodeTransformation =
+                glm::translate(glm::mat4(1.0f), i_translation) * glm::mat4_cast(i_rotation);
+            glm::fquat nodeRotation = glm::normalize(glm::quat_cast(NodeTransformation));
+            glm::vec3 nodeTranslation(NodeTransformation[3][0], NodeTransformation[3][1],
+                                      NodeTransformation[3][2]);
+            glm::fdualquat legacyDQ = glm::normalize(MakeDualQuat(nodeRotation, nodeTranslation));
+            validateDualQuat(node, NodeDQ, legacyDQ);
+#endif
+        }
+
+        glm::fdualquat& GlobalDQ = m_globalDQs[i_node];
+        GlobalDQ = isRoot ? NodeDQ : glm::normalize(m_globalDQs[node.parent] * NodeDQ);
+
+        if (NodeIndex != RigNode::NO_BONE)
         {
-            return i;
+            if (i_mode == SkinningMode::DQS)
+            {
+                // no matrix to read the joint position from: t = 2 * dual * conjugate(real)
+                glm::quat t = (GlobalDQ.dual * 2.0f) * glm::conjugate(GlobalDQ.real);
+                skeleton_pose[NodeIndex] = glm::vec3(t.x, t.y, t.z);
+            }
+
+            glm::fdualquat finalDQ = glm::normalize(GlobalDQ * m_BoneInfo[NodeIndex].offsetDQ);
+            m_BoneInfo[NodeIndex].FinalTransDQ = finalDQ;
         }
     }
+}
+
+//----------------------------------------------------------------
 
-    assert(0);
-    return 0;
+void Model::validateDualQuat(const RigNode& i_node, const glm::fdualquat& i_dq,
+                             const glm::fdualquat& i_legacyDQ) const
+{
+    // q and -q are the same rotation, quat_cast picks its own sign
+    const float sign = glm::dot(i_dq.real, i_legacyDQ.real) < 0.0f ? -1.0f : 1.0f;
+    const glm::vec4 realError = glm::vec4(i_dq.real.x, i_dq.real.y, i_dq.real.z, i_dq.real.w) -
+                                sign * glm::vec4(i_legacyDQ.real.x, i_legacyDQ.real.y,
+                                                 i_legacyDQ.real.z, i_legacyDQ.real.w);
+    const glm::vec4 dualError = glm::vec4(i_dq.dual.x, i_dq.dual.y, i_dq.dual.z, i_dq.dual.w) -
+                                sign * glm::vec4(i_legacyDQ.dual.x, i_legacyDQ.dual.y,
+                                                 i_legacyDQ.dual.z, i_legacyDQ.dual.w);
+
+    // the dual part scales with the translation
+    const float dualScale = std::max(1.0f, glm::length(glm::vec4(i_legacyDQ.dual.x,
+                                                                 i_legacyDQ.dual.y,
+                                                                 i_legacyDQ.dual.z,
+                                                                 i_legacyDQ.dual.w)));
+    const float tolerance = 1e-4f;
+    if (glm::length(realError) > tolerance || glm::length(dualError) > tolerance * dualScale)
+    {
+        std::cout << "[Model] Dual quaternion of " << i_node.name << " differs from the matrix path"
+                  << " (real " << glm::length(realError) << ", dual " << glm::length(dualError)
+                  << ")" << std::endl;
+    }
 }
 
 //----------------------------------------------------------------
 
-unsigned int Model::FindPosition(float AnimationTime, const aiNodeAnim* pNodeAnim)
+void Model::foldStaticNodes()
 {
-    for (unsigned int i = 0; i < pNodeAnim->mNumPositionKeys - 1; i++)
+    const std::vector<RigNode>& nodes = m_rig.GetNodes();
+    m_dynamicNodes.clear();
+    m_foldReport = FoldReport();
+    m_foldReport.numNodes = static_cast<unsigned int>(nodes.size());
+
+    for (const std::shared_ptr<const AnimationClip>& clip : m_clips)
+    {
+        m_foldReport.numChannels += clip->GetNumChannels();
+        m_foldReport.numConstantChannels += clip->GetNumConstantChannels();
+    }
+
+    std::vector<unsigned char> isStatic(nodes.size(), 0);
+    for (unsigned int i = 0; i < nodes.size(); ++i)
     {
-        if (AnimationTime < (float)pNodeAnim->mPositionKeys[i + 1].mTime)
+        const RigNode& node = nodes[i];
+
+        // the local transform is static when every clip leaves it at one and the same value:
+        // absent channels hold the bind pose, additive channels have to be the identity
+        bool staticLocal = true;
+        bool animated = false;
+        glm::quat rotation = node.bindRotation;
+        glm::vec3 translation = node.bindTranslation;
+        bool hasValue = false;
+
+        for (const std::shared_ptr<const AnimationClip>& clip : m_clips)
+        {
+            const unsigned int c = clip->GetNodeChannel(i);
+            glm::quat clipRotation = node.bindRotation;
+            glm::vec3 clipTranslation = node.bindTranslation;
+
+            if (c != AnimationClip::NO_CHANNEL)
+            {
+                const AnimationChannel& channel = clip->GetChannel(c);
+                if (!channel.constant)
+                {
+                    staticLocal = false;
+                    break;
+                }
+
+                if (clip->IsAdditive())
+                {
+                    const glm::quat Identity(1.0f, 0.0f, 0.0f, 0.0f);
+                    staticLocal = NearlyEqual(channel.constantRotation, Identity) &&
+                                  NearlyEqual(channel.constantPosition, glm::vec3(0.0f));
+                    if (!staticLocal)
+                    {
+                        break;
+                    }
+                    continue;
+                }
+
+                clipRotation = channel.constantRotation;
+                clipTranslation = channel.constantPosition;
+                animated = true;
+            }
+            else if (clip->IsAdditive())
+            {
+                continue;
+            }
+
+            if (hasValue && (!NearlyEqual(rotation, clipRotation) ||
+                             !NearlyEqual(translation, clipTranslation)))
+            {
+                staticLocal = false;
+                break;
+            }
+            rotation = clipRotation;
+            translation = clipTranslation;
+            hasValue = true;
+        }
+
+        const bool isRoot = node.parent == RigNode::NO_PARENT;
+        isStatic[i] = staticLocal && (isRoot || isStatic[node.parent]);
+
+        if (!isStatic[i])
+        {
+            m_dynamicNodes.push_back(i);
+            continue;
+        }
+
+        // bake the global transform once, evaluated like an animated node would be
+        evaluateNode(i, animated, rotation, translation, SkinningMode::Hybrid);
+
+        ++m_foldReport.numStaticNodes;
+        if (node.boneIndex != RigNode::NO_BONE)
         {
-            return i;
+            ++m_foldReport.numFoldedBones;
         }
     }
-    assert(0);
-    return 0;
+
+    for (const RigNode& node : nodes)
+    {
+        m_foldReport.numBones += node.boneIndex != RigNode::NO_BONE ? 1 : 0;
+    }
+
+    std::cout << "[Model] Folded " << m_foldReport.numFoldedBones << " of "
+              << m_foldReport.numBones << " bones (" << m_foldReport.numStaticNodes << " of "
+              << m_foldReport.numNodes << " nodes static, " << m_foldReport.numConstantChannels
+              << " of " << m_foldReport.numChannels << " channels constant)" << std::endl;
 }
 
 //----------------------------------------------------------------
 // HELPER FUNCTIONS
 //----------------------------------------------------------------
 
-unsigned int TextureFromFile(const char* path, const std::string& directory)
+GpuResource TextureFromFile(const char* path, const std::string& directory)
 {
     std::string filename = std::string(path);
     filename = directory + '/' + filename;
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
+    GpuResource texture(GpuResourceType::Texture);
+    const unsigned int textureID = texture.Get();
 
     int width, height, nrComponents;
     unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
@@ -591,7 +1140,7 @@ unsigned int TextureFromFile(const char* path, const std::string& directory)
         stbi_image_free(data);
     }
 
-    return textureID;
+    return texture;
 }
 
 //----------------------------------------------------------------
@@ -650,21 +1199,22 @@ glm::quat quatcast(glm::mat4 t)
 
 glm::mat3x4 convertMatrix(glm::mat4 s)
 {
+    // t[r] is row r of s, the last row of an affine matrix is always (0, 0, 0, 1)
     glm::mat3x4 t;
     t[0][0] = s[0][0];
-    t[0][1] = s[0][1];
-    t[0][2] = s[0][2];
-    t[0][3] = s[0][3];
+    t[0][1] = s[1][0];
+    t[0][2] = s[2][0];
+    t[0][3] = s[3][0];
 
-    t[1][0] = s[1][0];
+    t[1][0] = s[0][1];
     t[1][1] = s[1][1];
-    t[1][2] = s[1][2];
-    t[1][3] = s[1][3];
+    t[1][2] = s[2][1];
+    t[1][3] = s[3][1];
 
-    t[2][0] = s[2][0];
-    t[2][1] = s[2][1];
+    t[2][0] = s[0][2];
+    t[2][1] = s[1][2];
     t[2][2] = s[2][2];
-    t[2][3] = s[2][3];
+    t[2][3] = s[3][2];
 
     return t;
 }
\ No newline at end of file
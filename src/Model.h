@@ -8,7 +8,9 @@
 #include <gtc/type_ptr.hpp>
 #define GLM_ENABLE_EXPERIMENTAL
 #define GLM_FORCE_CTOR_INIT
+#include "AnimationClip.h"
 #include "Mesh.h"
+#include "Rig.h"
 #include "Shader.h"
 #include <gtx/dual_quaternion.hpp>
 #include <gtx/quaternion.hpp>
@@ -16,6 +18,7 @@
 #include <fstream>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -24,19 +27,55 @@
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
 
-unsigned int TextureFromFile(const char* path, const std::string& directory);
+GpuResource TextureFromFile(const char* path, const std::string& directory);
+// rows of the affine part of s, the compact bone matrix layout of the GPU palettes
 glm::mat3x4 convertMatrix(glm::mat4 s);
 glm::quat quatcast(glm::mat4 t);
 
-typedef std::map<std::string, const aiNodeAnim*> nodeAnimationMap;
-typedef std::map<std::string, nodeAnimationMap> AnimationMap;
+// Result of folding the nodes no clip can move
+struct FoldReport
+{
+    unsigned int numNodes = 0;
+    unsigned int numStaticNodes = 0;
+    unsigned int numBones = 0;
+    unsigned int numFoldedBones = 0;
+    // over all clips
+    unsigned int numChannels = 0;
+    unsigned int numConstantChannels = 0;
+};
+
+// How the bone weights of the file become vertex influences
+struct InfluenceSettings
+{
+    // influences kept per vertex, the largest ones, at most NUM_BONES_PER_VERTEX
+    unsigned int maxInfluences = NUM_BONES_PER_VERTEX;
+    // weights below this share of the vertex's total weight are dropped before renormalizing
+    float minWeight = 0.01f;
+};
+
+// What was kept of the bone weights, over all meshes
+struct InfluenceReport
+{
+    unsigned int numVertices = 0;
+    // vertices without any weight
+    unsigned int numUnweighted = 0;
+    // vertices that lost weights below InfluenceSettings::minWeight
+    unsigned int numPruned = 0;
+    // vertices with more weights above the threshold than InfluenceSettings::maxInfluences
+    unsigned int numTruncated = 0;
+    // over all vertices
+    unsigned int numSourceInfluences = 0;
+    unsigned int numInfluences = 0;
+    // most weights of a single vertex in the file
+    unsigned int maxSourceInfluences = 0;
+};
 
 class Model
 {
   public:
     // Ctor
     Model() = delete;
-    Model(const std::string& i_path);
+    Model(const std::string& i_path, const InfluenceSettings& i_influences = InfluenceSettings());
 
     // Copy Ctor
     Model(const Model& i_model) = delete;
@@ -65,14 +104,167 @@ class Model
     // Draws the model, and thus all its meshes
     void Draw(const Shader& i_shader);
 
+    // skin every mesh once into its transform feedback buffer. The bound program has to be a
+    // feedback Shader capturing FragPos, Normal and TexCoord, with an identity model matrix.
+    void SkinToFeedback();
+
+    // hand the CPU skinned vertices of a mesh to Mesh::UploadSkinned
+    void UploadSkinned(unsigned int i_mesh, const SkinnedVertex* i_vertices);
+
+    // draw the meshes skinned by the last SkinToFeedback or UploadSkinned, as often as needed
+    // per frame
+    void DrawSkinned(const Shader& i_shader);
+
     void BoneTransform(const float& i_timeInSeconds, std::vector<glm::mat4>& i_transforms,
                        std::vector<glm::fdualquat>& io_dqs);
 
+    // only evaluates the representation the skinning mode reads: LBS skips all dual quaternion
+    // math and leaves io_dqs untouched, DQS skips the matrices and leaves io_transforms untouched
+    void BoneTransform(const float& i_timeInSeconds, SkinningMode i_mode,
+                       std::vector<glm::mat4>& io_transforms, std::vector<glm::fdualquat>& io_dqs);
+
+    // same, writing straight into palette memory such as a mapped BonePalette region: m_NumBones
+    // matrices in the convertMatrix layout (LBS, hybrid) and m_NumBones dual quaternions in the
+    // glm::mat2x4_cast layout (DQS, hybrid). The pointer the mode does not write may be null.
+    // Without clips the bind pose palettes are written.
+    void BoneTransform(const float& i_timeInSeconds, SkinningMode i_mode,
+                       glm::mat3x4* o_transforms, glm::mat2x4* o_dqs);
+
+    // reuse the compiled clips of another model loaded with the same rig
+    // returns false (and keeps its own clips) when the rigs do not match
+    bool ShareAnimations(const Model& i_source);
+
+    // start playing a clip from its first frame, returns false for an unknown clip
+    bool PlayClip(unsigned int i_clip);
+    bool PlayClip(const std::string& i_name);
+
+    // blend from the playing clip to another one over i_duration seconds. A crossfade started
+    // while another one is running first completes the running one.
+    bool CrossfadeTo(unsigned int i_clip, float i_duration);
+    bool CrossfadeTo(const std::string& i_name, float i_duration);
+
+    // returns the index of the clip with the given name or -1
+    int FindClip(const std::string& i_name) const;
+
+    // add an additive copy of i_source holding its deltas from the pose of i_reference at
+    // i_referenceTime (in ticks). Returns the index of the new clip, or -1 for an unknown clip
+    // or if i_source is already resampled.
+    int AddAdditiveClip(unsigned int i_source, unsigned int i_reference,
+                        float i_referenceTime = 0.0f);
+
+    // add a layer playing a clip on top of the base clip, returns the layer index or -1 for an
+    // unknown clip. Additive clips are added to the pose, other clips replace it by the layer
+    // weight.
+    int AddLayer(unsigned int i_clip, float i_weight = 1.0f);
+
+    // per bone weights of a layer, indexed like Bone_Mapping. Bones past the end weigh 0.
+    // Returns false for an unknown layer, as does SetLayerWeight.
+    bool SetLayerMask(unsigned int i_layer, const std::vector<float>& i_boneWeights);
+
+    bool SetLayerWeight(unsigned int i_layer, float i_weight);
+
+    // mask weighing 1 for the given bone and every bone below it, e.g. an upper body mask
+    std::vector<float> MakeBoneMask(const std::string& i_rootBone) const;
+
+    // replace a clip by a copy resampled at the given rate (samples per second). Other models
+    // sharing the clip keep the original. Compressed clips are refused with an empty report.
+    ClipReport ResampleClip(unsigned int i_clip, float i_sampleRate);
+
+    // replace a clip by a quantized copy, resampled at the given rate if it is not already.
+    // Compressed clips are refused with an empty report.
+    ClipReport CompressClip(unsigned int i_clip, float i_sampleRate);
+
+    const std::vector<std::shared_ptr<const AnimationClip>>& GetClips() const
+    {
+        return m_clips;
+    }
+
+    const FoldReport& GetFoldReport() const
+    {
+        return m_foldReport;
+    }
+
+    const InfluenceReport& GetInfluenceReport() const
+    {
+        return m_influenceReport;
+    }
+
+    const std::vector<Mesh>& GetMeshes() const
+    {
+        return m_meshes;
+    }
+
   private:
+    // Flattened node hierarchy, evaluated every frame instead of walking the aiNode tree
+    Rig m_rig;
+
+    // Clips compiled against m_rig, possibly shared with other models
+    std::vector<std::shared_ptr<const AnimationClip>> m_clips;
+
+    // Playback state of one clip
+    struct ClipPlayback
+    {
+        unsigned int clip = 0;
+        // time in seconds the clip started at, negative until the next BoneTransform
+        float startTime = -1.0f;
+        // key search cursors, one per channel. Kept per instance because clips are shared.
+        std::vector<KeyCursor> cursors;
+    };
+
+    ClipPlayback m_playback;
+    ClipPlayback m_fadeTarget;
+    bool m_fading = false;
+    float m_fadeStart = -1.0f;
+    float m_fadeDuration = 0.0f;
+
+    // Channel of a layer clip with a non-zero mask weight
+    struct LayerChannel
+    {
+        unsigned int channel = 0;
+        unsigned int node = 0;
+        float weight = 0.0f;
+    };
+
+    // Clip played on top of the base clip
+    struct AnimationLayer
+    {
+        ClipPlayback playback;
+        float weight = 1.0f;
+        // per bone mask over the Bone_Mapping index space
+        std::vector<float> boneMask;
+        // sparse list of the channels the mask lets through, only these are sampled
+        std::vector<LayerChannel> channels;
+    };
+
+    std::vector<AnimationLayer> m_layers;
+
+    // Pre-allocated local poses of the played clip and of the crossfade target
+    Pose m_pose;
+    Pose m_fadePose;
+
+    // Per node global transforms of the last evaluated frame (indexed like the rig nodes)
+    std::vector<glm::mat4> m_globalTransforms;
+    std::vector<glm::fdualquat> m_globalDQs;
+
+    // Nodes whose global transform can change, in rig order. The globals of every other node
+    // are baked by foldStaticNodes and never evaluated per frame.
+    std::vector<unsigned int> m_dynamicNodes;
+    FoldReport m_foldReport;
+
+    InfluenceSettings m_influenceSettings;
+    InfluenceReport m_influenceReport;
+
+    // One weight of a vertex as listed by the file
+    struct BoneWeight
+    {
+        unsigned int boneIndex = 0;
+        float weight = 0.0f;
+    };
+
     // Model has ownership over the loaded scene
     // The application is now responsible for deleting the scene
     // The scene data is now heap allocated, so it requires application uses the same heap as Assimp
-    aiScene* m_scene;
+    aiScene* m_scene = nullptr;
 
     // Directory of the scene file
     std::string m_directory;
@@ -80,6 +272,13 @@ class Model
     // A number of meshes of the model
     std::vector<Mesh> m_meshes;
 
+    // GL textures of textures_loaded, deleted with the model
+    std::vector<GpuResource> m_textureObjects;
+
+    // sample the clips, crossfade and layers at the given time and evaluate the rig for the
+    // mode, returns false without clips
+    bool updatePose(float i_timeInSeconds, SkinningMode i_mode);
+
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in
     // the meshes vector.
     void loadModel(const std::string& i_path);
@@ -100,25 +299,46 @@ class Model
 
     void loadMeshBones(aiMesh* mesh, std::vector<VertexBoneData>& vertexBoneData);
 
+    // keep the largest weights of a vertex above the threshold and renormalize them, sorted
+    // from largest to smallest
+    void buildInfluences(std::vector<BoneWeight>& io_weights, VertexBoneData& o_boneData);
+
     // get animation from the bone
     // populate the animation map : animation_map[animation_name][bone_name] -> animation
     void loadAnimations(const std::string& BoneName, AnimationMap& o_animations);
 
-    void ReadNodeHeirarchy(float AnimationTime, const aiNode* pNode,
-                           const glm::mat4& ParentTransform, const glm::fdualquat& ParentDQ,
-                           glm::vec3 startpos);
+    // flatten the node hierarchy and compile the animations against it
+    void buildRig();
+
+    // reset a playback slot to the start of a clip
+    void startPlayback(unsigned int i_clip, ClipPlayback& o_playback);
+
+    // clip time in ticks of a playback slot at the given application time
+    float playbackTime(float i_timeInSeconds, ClipPlayback& io_playback);
+
+    // sample the local pose of a playback slot at the given application time
+    void samplePlayback(float i_timeInSeconds, ClipPlayback& io_playback, Pose& o_pose);
 
-    void CalcInterpolatedScaling(aiVector3D& Out, float AnimationTime, const aiNodeAnim* pNodeAnim);
+    // rebuild the sparse channel list of a layer from its mask
+    void buildLayerChannels(AnimationLayer& io_layer);
 
-    void CalcInterpolatedRotaion(aiQuaternion& Out, float AnimationTime,
-                                 const aiNodeAnim* pNodeAnim);
+    // apply a layer to the channels its mask lets through
+    void applyLayer(float i_timeInSeconds, AnimationLayer& io_layer, Pose& io_pose);
 
-    void CalcInterpolatedPosition(aiVector3D& Out, float AnimationTime,
-                                  const aiNodeAnim* pNodeAnim);
+    // find the nodes that keep the same local transform in every clip and bake the globals of
+    // the static subtrees. Has to run again whenever m_clips changes.
+    void foldStaticNodes();
 
-    unsigned int FindScaling(float AnimationTime, const aiNodeAnim* pNodeAnim);
+    // compute the global transforms the skinning mode needs for a node from its local rotation
+    // and translation (or from its bind pose when it is not animated), its parent has to be
+    // evaluated already
+    void evaluateNode(unsigned int i_node, bool i_animated, const glm::quat& i_rotation,
+                      const glm::vec3& i_translation, SkinningMode i_mode);
 
-    unsigned int FindRotation(float AnimationTime, const aiNodeAnim* pNodeAnim);
+    // report a node dual quaternion that does not match the legacy matrix round trip
+    void validateDualQuat(const RigNode& i_node, const glm::fdualquat& i_dq,
+                          const glm::fdualquat& i_legacyDQ) const;
 
-    unsigned int FindPosition(float AnimationTime, const aiNodeAnim* pNodeAnim);
+    // evaluate the global transform of every dynamic rig node in a single pass
+    void EvaluateRig(const Pose& i_pose, SkinningMode i_mode);
 };
\ No newline at end of file
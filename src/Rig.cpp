@@ -0,0 +1,161 @@
+#include "Rig.h"
+
+#include <gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+//----------------------------------------------------------------
+
+glm::fdualquat MakeDualQuat(const glm::fquat& rotation, const glm::vec3& translation)
+{
+    glm::fdualquat dq;
+    dq.real = rotation;
+    glm::fquat translationQuat(0.0f, translation.x, translation.y, translation.z);
+    dq.dual = 0.5f * translationQuat * rotation;
+    return dq;
+}
+
+//----------------------------------------------------------------
+
+bool NearlyEqual(const glm::quat& i_a, const glm::quat& i_b)
+{
+    const float tolerance = 1e-5f;
+    const glm::quat b = glm::dot(i_a, i_b) < 0.0f ? -i_b : i_b;
+    return std::abs(i_a.x - b.x) <= tolerance && std::abs(i_a.y - b.y) <= tolerance &&
+           std::abs(i_a.z - b.z) <= tolerance && std::abs(i_a.w - b.w) <= tolerance;
+}
+
+//----------------------------------------------------------------
+
+bool NearlyEqual(const glm::vec3& i_a, const glm::vec3& i_b)
+{
+    // relative to the magnitude, rigs come in any unit
+    const float tolerance = 1e-5f * std::max(1.0f, std::max(glm::length(i_a), glm::length(i_b)));
+    return glm::length(i_a - i_b) <= tolerance;
+}
+
+//----------------------------------------------------------------
+
+void Rig::Build(const aiNode* i_root, const std::map<std::string, unsigned int>& i_boneMapping)
+{
+    m_nodes.clear();
+    if (i_root != nullptr)
+    {
+        addNode(i_root, RigNode::NO_PARENT, i_boneMapping);
+    }
+}
+
+//----------------------------------------------------------------
+
+int Rig::FindNode(const std::string& i_name) const
+{
+    for (unsigned int i = 0; i < m_nodes.size(); ++i)
+    {
+        if (m_nodes[i].name == i_name)
+        {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+//----------------------------------------------------------------
+
+bool Rig::IsCompatible(const Rig& i_other) const
+{
+    if (m_nodes.size() != i_other.m_nodes.size())
+    {
+        return false;
+    }
+
+    for (unsigned int i = 0; i < m_nodes.size(); ++i)
+    {
+        if (m_nodes[i].name != i_other.m_nodes[i].name ||
+            m_nodes[i].parent != i_other.m_nodes[i].parent)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+//----------------------------------------------------------------
+
+void Rig::InitPose(Pose& o_pose) const
+{
+    o_pose.rotations.resize(m_nodes.size());
+    o_pose.translations.resize(m_nodes.size());
+    o_pose.animated.assign(m_nodes.size(), 0);
+
+    for (unsigned int i = 0; i < m_nodes.size(); ++i)
+    {
+        o_pose.rotations[i] = m_nodes[i].bindRotation;
+        o_pose.translations[i] = m_nodes[i].bindTranslation;
+    }
+}
+
+//----------------------------------------------------------------
+
+void Rig::BlendPose(const Pose& i_target, float i_weight, Pose& io_pose) const
+{
+    for (unsigned int i = 0; i < m_nodes.size(); ++i)
+    {
+        if (!io_pose.animated[i] && !i_target.animated[i])
+        {
+            continue;
+        }
+
+        const RigNode& node = m_nodes[i];
+        const glm::quat from = io_pose.animated[i] ? io_pose.rotations[i] : node.bindRotation;
+        glm::quat to = i_target.animated[i] ? i_target.rotations[i] : node.bindRotation;
+        const glm::vec3 fromTranslation =
+            io_pose.animated[i] ? io_pose.translations[i] : node.bindTranslation;
+        const glm::vec3 toTranslation =
+            i_target.animated[i] ? i_target.translations[i] : node.bindTranslation;
+
+        // blend along the shortest arc
+        if (glm::dot(from, to) < 0.0f)
+        {
+            to = -to;
+        }
+
+        io_pose.rotations[i] = glm::normalize(from * (1.0f - i_weight) + to * i_weight);
+        io_pose.translations[i] = glm::mix(fromTranslation, toTranslation, i_weight);
+        io_pose.animated[i] = 1;
+    }
+}
+
+//----------------------------------------------------------------
+
+void Rig::addNode(const aiNode* i_node, int i_parent,
+                  const std::map<std::string, unsigned int>& i_boneMapping)
+{
+    RigNode node;
+    node.name = i_node->mName.data;
+    node.parent = i_parent;
+
+    auto bone = i_boneMapping.find(node.name);
+    if (bone != i_boneMapping.end())
+    {
+        node.boneIndex = static_cast<int>(bone->second);
+    }
+
+    aiMatrix4x4 tp1 = i_node->mTransformation;
+    node.bindLocal = glm::transpose(glm::make_mat4(&tp1.a1));
+
+    // same conversion the animated nodes go through every frame
+    node.bindRotation = glm::normalize(glm::quat_cast(node.bindLocal));
+    node.bindTranslation = glm::vec3(node.bindLocal[3][0], node.bindLocal[3][1],
+                                     node.bindLocal[3][2]);
+    node.bindLocalDQ = glm::normalize(MakeDualQuat(node.bindRotation, node.bindTranslation));
+
+    // depth first pre-order keeps every parent in front of its children
+    int index = static_cast<int>(m_nodes.size());
+    m_nodes.push_back(node);
+
+    for (unsigned int i = 0; i < i_node->mNumChildren; ++i)
+    {
+        addNode(i_node->mChildren[i], index, i_boneMapping);
+    }
+}
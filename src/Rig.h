@@ -0,0 +1,97 @@
+#pragma once
+
+#include <glm.hpp>
+#include <gtc/quaternion.hpp>
+#define GLM_ENABLE_EXPERIMENTAL
+#include <gtx/dual_quaternion.hpp>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <assimp/scene.h>
+
+glm::fdualquat MakeDualQuat(const glm::fquat& rotation, const glm::vec3& translation);
+
+// true when two local rotations (either sign) or translations only differ by float noise
+bool NearlyEqual(const glm::quat& i_a, const glm::quat& i_b);
+bool NearlyEqual(const glm::vec3& i_a, const glm::vec3& i_b);
+
+//------------------------------------------------------
+// RIG NODE
+//------------------------------------------------------
+
+struct RigNode
+{
+    static constexpr int NO_PARENT = -1;
+    static constexpr int NO_BONE = -1;
+
+    // node name, only used while loading
+    std::string name;
+    // index of the parent node, always smaller than the index of this node
+    int parent = NO_PARENT;
+    // index into Bone_Mapping / m_BoneInfo
+    int boneIndex = NO_BONE;
+    // bind pose transformation relative to the parent
+    glm::mat4 bindLocal = glm::mat4(1.0f);
+    glm::fdualquat bindLocalDQ;
+    // bind pose rotation and translation, used when blending against a clip that does not
+    // animate this node
+    glm::quat bindRotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    glm::vec3 bindTranslation = glm::vec3(0.0f);
+};
+
+//------------------------------------------------------
+// POSE
+//------------------------------------------------------
+
+// Local rotation and translation of every rig node
+struct Pose
+{
+    std::vector<glm::quat> rotations;
+    std::vector<glm::vec3> translations;
+    // 1 when the node is driven by a clip, otherwise the node keeps its bind pose
+    std::vector<unsigned char> animated;
+};
+
+//------------------------------------------------------
+// RIG CLASS
+//------------------------------------------------------
+
+// Flattened node hierarchy of a scene, built once at load. Nodes are stored in topological
+// order (parents before children) so the hierarchy can be evaluated with a single linear loop.
+class Rig
+{
+  public:
+    // build the flattened hierarchy from the scene root
+    void Build(const aiNode* i_root, const std::map<std::string, unsigned int>& i_boneMapping);
+
+    // returns the index of the node with the given name or -1
+    int FindNode(const std::string& i_name) const;
+
+    // rigs are compatible when they hold the same nodes in the same order
+    bool IsCompatible(const Rig& i_other) const;
+
+    // size a pose for this rig and reset it to the bind pose
+    void InitPose(Pose& o_pose) const;
+
+    // blend i_target over io_pose with the given weight (0 keeps io_pose). Nodes animated on only
+    // one side are blended against their bind pose.
+    void BlendPose(const Pose& i_target, float i_weight, Pose& io_pose) const;
+
+    const std::vector<RigNode>& GetNodes() const
+    {
+        return m_nodes;
+    }
+
+    unsigned int GetNumNodes() const
+    {
+        return static_cast<unsigned int>(m_nodes.size());
+    }
+
+  private:
+    void addNode(const aiNode* i_node, int i_parent,
+                 const std::map<std::string, unsigned int>& i_boneMapping);
+
+    std::vector<RigNode> m_nodes;
+};
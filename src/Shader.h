@@ -1,4 +1,6 @@
 #pragma once
+#include "GpuResource.h"
+
 #include <GL/glew.h>
 #include <glm.hpp>
 
@@ -6,62 +8,36 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <utility>
+#include <vector>
+
+// Names #defined in every stage of a program, right after the #version line. Compiles
+// specialized variants of one source file, e.g. {{"SKINNING_LBS"}}.
+struct ShaderDefines
+{
+    std::vector<std::string> names;
+};
 
+// Owns its program, which is deleted with the Shader. Moves only.
 class Shader
 {
   public:
-    unsigned int ID;
+    // GL name of the program, 0 once moved from
+    unsigned int ID = 0;
 
     // constructor generates the shader on the fly
     // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath)
+    Shader(const char* vertexPath, const char* fragmentPath,
+           const ShaderDefines& defines = ShaderDefines())
     {
         // 1. retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        try
-        {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();
-        }
-        catch (std::ifstream::failure e)
-        {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
-        }
-        const char* vShaderCode = vertexCode.c_str();
-        const char* fShaderCode = fragmentCode.c_str();
+        std::string vertexCode = addDefines(readFile(vertexPath), defines);
+        std::string fragmentCode = addDefines(readFile(fragmentPath), defines);
         // 2. compile shaders
-        unsigned int vertex, fragment;
-        int success;
-        char infoLog[512];
-        // vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
-        // fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
+        unsigned int vertex = compileShader(GL_VERTEX_SHADER, vertexCode, "VERTEX");
+        unsigned int fragment = compileShader(GL_FRAGMENT_SHADER, fragmentCode, "FRAGMENT");
         // shader Program
-        ID = glCreateProgram();
+        createProgram();
         glAttachShader(ID, vertex);
         glAttachShader(ID, fragment);
         glLinkProgram(ID);
@@ -70,6 +46,64 @@ class Shader
         glDeleteShader(vertex);
         glDeleteShader(fragment);
     }
+
+    // vertex only program for transform feedback: the listed vertex shader outputs are captured
+    // interleaved, in order, into the buffer bound to GL_TRANSFORM_FEEDBACK_BUFFER index 0. Draw
+    // with GL_RASTERIZER_DISCARD enabled.
+    // ------------------------------------------------------------------------
+    Shader(const char* vertexPath, const std::vector<std::string>& feedbackVaryings,
+           const ShaderDefines& defines = ShaderDefines())
+    {
+        std::string vertexCode = addDefines(readFile(vertexPath), defines);
+        unsigned int vertex = compileShader(GL_VERTEX_SHADER, vertexCode, "VERTEX");
+
+        std::vector<const char*> varyings;
+        for (const std::string& varying : feedbackVaryings)
+        {
+            varyings.push_back(varying.c_str());
+        }
+
+        createProgram();
+        glAttachShader(ID, vertex);
+        // has to be set before linking
+        glTransformFeedbackVaryings(ID, (GLsizei)varyings.size(), varyings.data(),
+                                    GL_INTERLEAVED_ATTRIBS);
+        glLinkProgram(ID);
+        checkCompileErrors(ID, "PROGRAM");
+        glDeleteShader(vertex);
+    }
+
+    // compute program, needs a GL 4.3 context
+    // ------------------------------------------------------------------------
+    explicit Shader(const char* computePath, const ShaderDefines& defines = ShaderDefines())
+    {
+        std::string computeCode = addDefines(readFile(computePath), defines);
+        unsigned int compute = compileShader(GL_COMPUTE_SHADER, computeCode, "COMPUTE");
+
+        createProgram();
+        glAttachShader(ID, compute);
+        glLinkProgram(ID);
+        checkCompileErrors(ID, "PROGRAM");
+        glDeleteShader(compute);
+    }
+
+    Shader(const Shader& i_shader) = delete;
+    Shader& operator=(const Shader& i_shader) = delete;
+
+    Shader(Shader&& io_shader) noexcept
+        : ID(io_shader.ID), m_program(std::move(io_shader.m_program))
+    {
+        io_shader.ID = 0;
+    }
+
+    Shader& operator=(Shader&& io_shader) noexcept
+    {
+        m_program = std::move(io_shader.m_program);
+        ID = io_shader.ID;
+        io_shader.ID = 0;
+        return *this;
+    }
+
     // activate the shader
     // ------------------------------------------------------------------------
     void use()
@@ -141,6 +175,71 @@ class Shader
     }
 
   private:
+    // ------------------------------------------------------------------------
+    void createProgram()
+    {
+        m_program = GpuResource(GpuResourceType::Program);
+        ID = m_program.Get();
+    }
+
+    // read a whole shader file
+    // ------------------------------------------------------------------------
+    std::string readFile(const char* path)
+    {
+        std::ifstream shaderFile;
+        // ensure ifstream objects can throw exceptions:
+        shaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+        try
+        {
+            shaderFile.open(path);
+            std::stringstream shaderStream;
+            shaderStream << shaderFile.rdbuf();
+            shaderFile.close();
+            return shaderStream.str();
+        }
+        catch (std::ifstream::failure e)
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+        }
+        return std::string();
+    }
+
+    // insert the defines after the #version line, which has to come first
+    // ------------------------------------------------------------------------
+    std::string addDefines(const std::string& code, const ShaderDefines& defines)
+    {
+        if (defines.names.empty())
+        {
+            return code;
+        }
+
+        const size_t versionEnd = code.find('\n');
+        std::string header;
+        for (const std::string& name : defines.names)
+        {
+            header += "#define " + name + "\n";
+        }
+        // keep the line numbers of compile errors pointing into the file
+        header += "#line 2\n";
+
+        if (versionEnd == std::string::npos)
+        {
+            return code + "\n" + header;
+        }
+        return code.substr(0, versionEnd + 1) + header + code.substr(versionEnd + 1);
+    }
+
+    // ------------------------------------------------------------------------
+    unsigned int compileShader(GLenum type, const std::string& code, const std::string& typeName)
+    {
+        const char* shaderCode = code.c_str();
+        unsigned int shader = glCreateShader(type);
+        glShaderSource(shader, 1, &shaderCode, NULL);
+        glCompileShader(shader);
+        checkCompileErrors(shader, typeName);
+        return shader;
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(unsigned int shader, std::string type)
@@ -172,4 +271,6 @@ class Shader
             }
         }
     }
-};
\ No newline at end of file
+
+    GpuResource m_program;
+};
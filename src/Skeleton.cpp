@@ -3,27 +3,56 @@
 
 Skeleton::Skeleton(const vec3_map& i_skeletonMap)
 {
-    m_skeletonMap = i_skeletonMap;
-    initSkeleton();
+    initSkeleton(i_skeletonMap);
     setupSkeleton();
 }
 
+void Skeleton::Update(const vec3_map& i_skeletonMap)
+{
+    // clear keeps the capacity, so a pose of the same joints allocates nothing
+    indices.clear();
+    skeleton.clear();
+    initSkeleton(i_skeletonMap);
+
+    // the index buffer binding is VAO state, only touch it with the skeleton's VAO bound
+    glBindVertexArray(skeletonVAO.Get());
+    glBindBuffer(GL_ARRAY_BUFFER, VBO.Get());
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO.Get());
+    if (skeleton.size() > m_capacity)
+    {
+        // new joints, the VAO keeps pointing at the same buffer names
+        m_capacity = skeleton.size();
+        glBufferData(GL_ARRAY_BUFFER, skeleton.size() * sizeof(glm::vec3), skeleton.data(),
+                     GL_DYNAMIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int),
+                     indices.data(), GL_DYNAMIC_DRAW);
+    }
+    else
+    {
+        glBufferSubData(GL_ARRAY_BUFFER, 0, skeleton.size() * sizeof(glm::vec3), skeleton.data());
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, indices.size() * sizeof(unsigned int),
+                        indices.data());
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
 // render the Skeleton
 void Skeleton::Draw(Shader& i_shader)
 {
     i_shader.use();
-    glBindVertexArray(skeletonVAO);
+    glBindVertexArray(skeletonVAO.Get());
     // glDrawArrays(GL_POINTS, 0, skeleton.size());
     glDrawElements(GL_POINTS, indices.size(), GL_UNSIGNED_INT, 0);
 
     glBindVertexArray(0);
 }
 
-void Skeleton::initSkeleton()
+void Skeleton::initSkeleton(const vec3_map& i_skeletonMap)
 {
     /*skeleton.resize(skeleton_map.size());
     indices.resize(skeleton_map.size());*/
-    for (auto it = m_skeletonMap.cbegin(); it != m_skeletonMap.cend(); ++it)
+    for (auto it = i_skeletonMap.cbegin(); it != i_skeletonMap.cend(); ++it)
     {
         indices.push_back(it->first);
         skeleton.push_back(it->second);
@@ -32,19 +61,21 @@ void Skeleton::initSkeleton()
 
 void Skeleton::setupSkeleton()
 {
-    glGenVertexArrays(1, &skeletonVAO);
-    glBindVertexArray(skeletonVAO);
+    skeletonVAO = GpuResource(GpuResourceType::VertexArray);
+    glBindVertexArray(skeletonVAO.Get());
 
-    glGenBuffers(1, &EBO);
-    glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, skeleton.size() * sizeof(glm::vec3), &skeleton[0],
-                 GL_STATIC_DRAW);
+    EBO = GpuResource(GpuResourceType::Buffer);
+    VBO = GpuResource(GpuResourceType::Buffer);
+    m_capacity = skeleton.size();
+    glBindBuffer(GL_ARRAY_BUFFER, VBO.Get());
+    glBufferData(GL_ARRAY_BUFFER, skeleton.size() * sizeof(glm::vec3), skeleton.data(),
+                 GL_DYNAMIC_DRAW);
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0],
-                 GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO.Get());
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(),
+                 GL_DYNAMIC_DRAW);
 
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
+    glBindVertexArray(0);
 }
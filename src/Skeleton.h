@@ -1,5 +1,6 @@
 #pragma once
 
+#include "GpuResource.h"
 #include "Shader.h"
 
 #include <glm.hpp>
@@ -17,6 +18,9 @@ class Skeleton
     // Dtor
     ~Skeleton() {};
 
+    // upload a new pose into the existing buffers, they only grow when joints are added
+    void Update(const vec3_map& i_skeletonMap);
+
     // render the Skeleton
     void Draw(Shader& i_shader);
 
@@ -24,13 +28,14 @@ class Skeleton
     std::vector<glm::vec3> skeleton;
 
   private:
-    void initSkeleton();
+    // fill indices and skeleton from the joints of a pose
+    void initSkeleton(const vec3_map& i_skeletonMap);
 
     void setupSkeleton();
 
-    vec3_map m_skeletonMap;
-
-    unsigned int skeletonVAO;
-    unsigned int VBO;
-    unsigned int EBO;
-};
\ No newline at end of file
+    GpuResource skeletonVAO;
+    GpuResource VBO;
+    GpuResource EBO;
+    // joints the buffers hold storage for
+    size_t m_capacity = 0;
+};
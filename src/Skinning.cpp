@@ -0,0 +1,166 @@
+#include "Skinning.h"
+
+#include <cassert>
+
+//----------------------------------------------------------------
+
+glm::mat4 DQtoMat(const glm::vec4& i_real, const glm::vec4& i_dual)
+{
+    glm::mat4 m;
+    float len2 = glm::dot(i_real, i_real);
+    float w = i_real.w, x = i_real.x, y = i_real.y, z = i_real.z;
+    float t0 = i_dual.w, t1 = i_dual.x, t2 = i_dual.y, t3 = i_dual.z;
+
+    m[0][0] = w * w + x * x - y * y - z * z;
+    m[1][0] = 2 * x * y - 2 * w * z;
+    m[2][0] = 2 * x * z + 2 * w * y;
+    m[0][1] = 2 * x * y + 2 * w * z;
+    m[1][1] = w * w + y * y - x * x - z * z;
+    m[2][1] = 2 * y * z - 2 * w * x;
+    m[0][2] = 2 * x * z - 2 * w * y;
+    m[1][2] = 2 * y * z + 2 * w * x;
+    m[2][2] = w * w + z * z - x * x - y * y;
+
+    m[3][0] = -2 * t0 * x + 2 * w * t1 - 2 * t2 * z + 2 * y * t3;
+    m[3][1] = -2 * t0 * y + 2 * t1 * z - 2 * x * t3 + 2 * w * t2;
+    m[3][2] = -2 * t0 * z + 2 * x * t2 + 2 * w * t3 - 2 * t1 * y;
+
+    m[0][3] = 0;
+    m[1][3] = 0;
+    m[2][3] = 0;
+    m[3][3] = len2;
+    m /= len2;
+
+    return m;
+}
+
+//----------------------------------------------------------------
+
+glm::mat4 BlendBoneMatrices(const VertexBoneData& i_boneData,
+                            const std::vector<glm::mat4>& i_transforms)
+{
+    // unused slots point at bone 0 with a zero weight, exactly like in the vertex buffer
+    glm::mat4 BoneTransform = i_transforms[i_boneData.BoneIDs[0]] * i_boneData.Weights[0];
+    for (unsigned int i = 1; i < NUM_BONES_PER_VERTEX; ++i)
+    {
+        BoneTransform += i_transforms[i_boneData.BoneIDs[i]] * i_boneData.Weights[i];
+    }
+    return BoneTransform;
+}
+
+//----------------------------------------------------------------
+
+glm::mat2x4 BlendDualQuats(const VertexBoneData& i_boneData,
+                           const std::vector<glm::fdualquat>& i_dqs)
+{
+    const glm::mat2x4 dq0 = glm::mat2x4_cast(i_dqs[i_boneData.BoneIDs[0]]);
+    glm::mat2x4 blendDQ = dq0 * i_boneData.Weights[0];
+
+    for (unsigned int i = 1; i < NUM_BONES_PER_VERTEX; ++i)
+    {
+        glm::mat2x4 dq = glm::mat2x4_cast(i_dqs[i_boneData.BoneIDs[i]]);
+
+        // antipodal flip, q and -q are the same rotation but do not blend
+        if (glm::dot(dq0[0], dq[0]) < 0.0f)
+        {
+            dq *= -1.0f;
+        }
+        blendDQ += dq * i_boneData.Weights[i];
+    }
+
+    float len = glm::length(blendDQ[0]);
+    if (len > 0.0f)
+    {
+        blendDQ /= len;
+    }
+    return blendDQ;
+}
+
+//----------------------------------------------------------------
+
+glm::mat4 SkinningMatrix(const VertexBoneData& i_boneData,
+                         const std::vector<glm::mat4>& i_transforms,
+                         const std::vector<glm::fdualquat>& i_dqs, SkinningMode i_mode,
+                         float i_ratio)
+{
+    if (i_mode == SkinningMode::LBS)
+    {
+        return BlendBoneMatrices(i_boneData, i_transforms);
+    }
+
+    const glm::mat2x4 blendDQ = BlendDualQuats(i_boneData, i_dqs);
+    const glm::mat4 DQmat = DQtoMat(blendDQ[0], blendDQ[1]);
+    if (i_mode == SkinningMode::DQS)
+    {
+        return DQmat;
+    }
+
+    return (1 - i_ratio) * BlendBoneMatrices(i_boneData, i_transforms) + i_ratio * DQmat;
+}
+
+//----------------------------------------------------------------
+
+glm::vec3 CofactorNormal(const glm::mat4& i_M, const glm::vec3& i_normal)
+{
+    const glm::mat3 A(i_M);
+    const glm::mat3 cofactor(glm::cross(A[1], A[2]), glm::cross(A[2], A[0]),
+                             glm::cross(A[0], A[1]));
+    return cofactor * i_normal / glm::dot(A[0], cofactor[0]);
+}
+
+//----------------------------------------------------------------
+
+glm::vec3 RotateNormal(const glm::vec4& i_real, const glm::vec3& i_normal)
+{
+    const glm::vec3 axis(i_real);
+    return i_normal + 2.0f * glm::cross(axis, glm::cross(axis, i_normal) + i_real.w * i_normal);
+}
+
+//----------------------------------------------------------------
+
+void SkinVertices(const std::vector<Vertex>& i_vertices,
+                  const std::vector<VertexBoneData>& i_boneData,
+                  const std::vector<glm::mat4>& i_transforms,
+                  const std::vector<glm::fdualquat>& i_dqs, SkinningMode i_mode, float i_ratio,
+                  std::vector<glm::vec3>& o_positions, std::vector<glm::vec3>& o_normals)
+{
+    assert(i_vertices.size() == i_boneData.size());
+
+    o_positions.resize(i_vertices.size());
+    o_normals.resize(i_vertices.size());
+
+    for (unsigned int v = 0; v < i_vertices.size(); ++v)
+    {
+        if (i_mode == SkinningMode::DQS)
+        {
+            const glm::mat2x4 blendDQ = BlendDualQuats(i_boneData[v], i_dqs);
+            const glm::mat4 M = DQtoMat(blendDQ[0], blendDQ[1]);
+            o_positions[v] = glm::vec3(M * glm::vec4(i_vertices[v].Position, 1.0f));
+            o_normals[v] = RotateNormal(blendDQ[0], i_vertices[v].Normal);
+            continue;
+        }
+
+        const glm::mat4 M = SkinningMatrix(i_boneData[v], i_transforms, i_dqs, i_mode, i_ratio);
+        o_positions[v] = glm::vec3(M * glm::vec4(i_vertices[v].Position, 1.0f));
+        o_normals[v] = CofactorNormal(M, i_vertices[v].Normal);
+    }
+}
+
+//----------------------------------------------------------------
+
+void SkinMesh(const Mesh& i_mesh, const std::vector<glm::mat4>& i_transforms,
+              const std::vector<glm::fdualquat>& i_dqs, SkinningMode i_mode, float i_ratio,
+              std::vector<glm::vec3>& o_positions, std::vector<glm::vec3>& o_normals)
+{
+    // the quantized weights of the vertex buffer, as the shader reads them
+    const BoneEncoding& encoding = i_mesh.GetBoneEncoding();
+    const std::vector<unsigned char>& packed = i_mesh.GetPackedBoneData();
+    std::vector<VertexBoneData> boneData(i_mesh.GetVertices().size());
+    for (unsigned int v = 0; v < boneData.size(); ++v)
+    {
+        boneData[v] = DecodeBoneData(&packed[v * encoding.GetStride()], encoding);
+    }
+
+    SkinVertices(i_mesh.GetVertices(), boneData, i_transforms, i_dqs, i_mode, i_ratio,
+                 o_positions, o_normals);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Mesh.h"
+
+#include <glm.hpp>
+#define GLM_ENABLE_EXPERIMENTAL
+#include <gtx/dual_quaternion.hpp>
+
+#include <vector>
+
+//------------------------------------------------------
+// CPU SKINNING
+//------------------------------------------------------
+
+// Reference implementation of res/shaders/vertex.shader on the CPU, for offline baking and for
+// checking the GPU paths without a GL context. The palettes are the ones filled by
+// Model::BoneTransform. Every function follows the shader math operation by operation, so the
+// results only differ from the GPU by float rounding.
+
+// same layout and math as DQtoMat in the vertex shader: real and dual are (x, y, z, w)
+glm::mat4 DQtoMat(const glm::vec4& i_real, const glm::vec4& i_dual);
+
+// weighted sum of the bone matrices of a vertex
+glm::mat4 BlendBoneMatrices(const VertexBoneData& i_boneData,
+                            const std::vector<glm::mat4>& i_transforms);
+
+// weighted sum of the bone dual quaternions of a vertex, every influence flipped into the
+// hemisphere of the first one and the sum divided by the length of its real part
+glm::mat2x4 BlendDualQuats(const VertexBoneData& i_boneData,
+                           const std::vector<glm::fdualquat>& i_dqs);
+
+// skinning matrix of a vertex for the given mode, ratio only matters for the hybrid mode:
+// (1 - ratio) * LBS + ratio * DQtoMat(DQS)
+glm::mat4 SkinningMatrix(const VertexBoneData& i_boneData,
+                         const std::vector<glm::mat4>& i_transforms,
+                         const std::vector<glm::fdualquat>& i_dqs, SkinningMode i_mode,
+                         float i_ratio);
+
+// CofactorNormal in the shader: the inverse transpose of the upper 3x3 of M applied to n, built
+// from the cofactor matrix and the determinant instead of a 4x4 inverse
+glm::vec3 CofactorNormal(const glm::mat4& i_M, const glm::vec3& i_normal);
+
+// RotateNormal in the shader: rotate n by the real part (x, y, z, w) of a unit dual quaternion
+glm::vec3 RotateNormal(const glm::vec4& i_real, const glm::vec3& i_normal);
+
+// skin every vertex into model space. Like the shader, DQS rotates the normals by the blended
+// dual quaternion and LBS / hybrid use CofactorNormal. Normals are not normalized.
+void SkinVertices(const std::vector<Vertex>& i_vertices,
+                  const std::vector<VertexBoneData>& i_boneData,
+                  const std::vector<glm::mat4>& i_transforms,
+                  const std::vector<glm::fdualquat>& i_dqs, SkinningMode i_mode, float i_ratio,
+                  std::vector<glm::vec3>& o_positions, std::vector<glm::vec3>& o_normals);
+
+// skin the vertices of a mesh with the bone data decoded from its vertex buffer encoding, so the
+// weights carry the same quantization as on the GPU
+void SkinMesh(const Mesh& i_mesh, const std::vector<glm::mat4>& i_transforms,
+              const std::vector<glm::fdualquat>& i_dqs, SkinningMode i_mode, float i_ratio,
+              std::vector<glm::vec3>& o_positions, std::vector<glm::vec3>& o_normals);
@@ -0,0 +1,119 @@
+#include "SkinningKernel.inl"
+
+// built with -mavx2 (/arch:AVX2 on MSVC), see CMakeLists.txt
+#if defined(__AVX2__)
+#define SKINNING_AVX2 1
+#include <immintrin.h>
+#endif
+
+#if SKINNING_AVX2
+namespace
+{
+// eight vertices per iteration
+struct AVX2Lanes
+{
+    static constexpr unsigned int WIDTH = 8;
+    typedef __m256 Mask;
+
+    struct F
+    {
+        __m256 v;
+    };
+
+    friend F operator+(F i_a, F i_b)
+    {
+        return {_mm256_add_ps(i_a.v, i_b.v)};
+    }
+
+    friend F operator-(F i_a, F i_b)
+    {
+        return {_mm256_sub_ps(i_a.v, i_b.v)};
+    }
+
+    friend F operator*(F i_a, F i_b)
+    {
+        return {_mm256_mul_ps(i_a.v, i_b.v)};
+    }
+
+    friend F operator/(F i_a, F i_b)
+    {
+        return {_mm256_div_ps(i_a.v, i_b.v)};
+    }
+
+    static F Set1(float i_value)
+    {
+        return {_mm256_set1_ps(i_value)};
+    }
+
+    static F Load(const float* i_source)
+    {
+        return {_mm256_loadu_ps(i_source)};
+    }
+
+    static F LoadUnorm(const unsigned char* i_source, F i_maxWeight)
+    {
+        const __m256i values =
+            _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(i_source)));
+        return {_mm256_div_ps(_mm256_cvtepi32_ps(values), i_maxWeight.v)};
+    }
+
+    static F LoadUnorm(const unsigned short* i_source, F i_maxWeight)
+    {
+        const __m256i values =
+            _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(i_source)));
+        return {_mm256_div_ps(_mm256_cvtepi32_ps(values), i_maxWeight.v)};
+    }
+
+    static void Store(float* o_destination, F i_value)
+    {
+        _mm256_storeu_ps(o_destination, i_value.v);
+    }
+
+    static F Gather(const float* i_base, const int* i_offsets)
+    {
+        const __m256i offsets = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(i_offsets));
+        return {_mm256_i32gather_ps(i_base, offsets, 4)};
+    }
+
+    static Mask Less(F i_a, F i_b)
+    {
+        return _mm256_cmp_ps(i_a.v, i_b.v, _CMP_LT_OQ);
+    }
+
+    static F Select(Mask i_mask, F i_a, F i_b)
+    {
+        return {_mm256_blendv_ps(i_b.v, i_a.v, i_mask)};
+    }
+
+    static F Sqrt(F i_value)
+    {
+        return {_mm256_sqrt_ps(i_value.v)};
+    }
+};
+} // namespace
+#endif
+
+//----------------------------------------------------------------
+
+bool HasAVX2Kernel()
+{
+#if SKINNING_AVX2
+    return true;
+#else
+    return false;
+#endif
+}
+
+//----------------------------------------------------------------
+
+void SkinStreamsAVX2(const SkinningStreams& i_streams, const SkinningPalette& i_palette,
+                     SkinningMode i_mode, float i_ratio, unsigned int i_begin, unsigned int i_end,
+                     SkinnedStreams& io_output)
+{
+#if SKINNING_AVX2
+    SkinStreamRange<AVX2Lanes>(i_streams, i_palette, i_mode, i_ratio, i_begin, i_end,
+                               io_output);
+#else
+    SkinStreamsScalar(i_streams, i_palette, i_mode, i_ratio, i_begin, i_end, io_output);
+#endif
+}
@@ -0,0 +1,225 @@
+// Skinning kernel shared by the scalar, SSE4.1 and AVX2 translation units. Lanes provides a float
+// vector type F holding Lanes::WIDTH vertices, a comparison mask type and the few operations the
+// kernel needs, so the math below is written once and follows Skinning.cpp step by step.
+
+#include "SkinningSIMD.h"
+
+// Index and Weight are the bone data types of the streams, unsigned char or unsigned short
+template <typename Lanes, typename Index, typename Weight>
+void SkinStreamBlocks(const SkinningStreams& i_streams, const Index* const* i_boneIds,
+                      const Weight* const* i_weights, const SkinningPalette& i_palette,
+                      SkinningMode i_mode, float i_ratio, unsigned int i_begin,
+                      unsigned int i_end, SkinnedStreams& io_output)
+{
+    typedef typename Lanes::F F;
+    const unsigned int WIDTH = Lanes::WIDTH;
+
+    const bool useMatrices = i_mode != SkinningMode::DQS;
+    const bool useDualQuats = i_mode != SkinningMode::LBS;
+
+    const F zero = Lanes::Set1(0.0f);
+    const F one = Lanes::Set1(1.0f);
+    const F minusOne = Lanes::Set1(-1.0f);
+    const F two = Lanes::Set1(2.0f);
+    const F ratio = Lanes::Set1(i_ratio);
+    const F lbsRatio = Lanes::Set1(1 - i_ratio);
+    const F maxWeight = Lanes::Set1(static_cast<float>(i_streams.encoding.GetMaxWeight()));
+
+    for (unsigned int v = i_begin; v < i_end; v += WIDTH)
+    {
+        // the other slots of the block are zero weighted
+        const unsigned int numInfluences = i_streams.blockInfluences[v / SKINNING_MAX_LANES];
+
+        // the last influence takes what the stored weights leave of 1, as in DecodeBoneData
+        F weights[NUM_BONES_PER_VERTEX];
+        F remaining = one;
+        for (unsigned int k = 0; k + 1 < numInfluences; ++k)
+        {
+            weights[k] = Lanes::LoadUnorm(&i_weights[k][v], maxWeight);
+            remaining = remaining - weights[k];
+        }
+        weights[numInfluences - 1] = remaining;
+
+        // blended 3x4 skinning matrix, row-major
+        F m[12];
+        int offsets[SKINNING_MAX_LANES];
+
+        if (useMatrices)
+        {
+            for (unsigned int c = 0; c < 12; ++c)
+            {
+                m[c] = zero;
+            }
+
+            for (unsigned int k = 0; k < numInfluences; ++k)
+            {
+                for (unsigned int l = 0; l < WIDTH; ++l)
+                {
+                    offsets[l] = i_boneIds[k][v + l] * 12;
+                }
+
+                for (unsigned int c = 0; c < 12; ++c)
+                {
+                    m[c] = m[c] + Lanes::Gather(&i_palette.matrices[c], offsets) * weights[k];
+                }
+            }
+        }
+
+        if (useDualQuats)
+        {
+            // blend with the antipodal flip against the first influence
+            F dq[8];
+            // set by the first influence, every block reads at least one
+            F first[4] = {zero, zero, zero, zero};
+            for (unsigned int k = 0; k < numInfluences; ++k)
+            {
+                for (unsigned int l = 0; l < WIDTH; ++l)
+                {
+                    offsets[l] = i_boneIds[k][v + l] * 8;
+                }
+
+                F bone[8];
+                for (unsigned int c = 0; c < 8; ++c)
+                {
+                    bone[c] = Lanes::Gather(&i_palette.dualQuats[c], offsets);
+                }
+
+                if (k == 0)
+                {
+                    for (unsigned int c = 0; c < 4; ++c)
+                    {
+                        first[c] = bone[c];
+                    }
+                    for (unsigned int c = 0; c < 8; ++c)
+                    {
+                        dq[c] = bone[c] * weights[k];
+                    }
+                    continue;
+                }
+
+                F d = first[0] * bone[0] + first[1] * bone[1] + first[2] * bone[2] +
+                      first[3] * bone[3];
+                F sign = Lanes::Select(Lanes::Less(d, zero), minusOne, one);
+                for (unsigned int c = 0; c < 8; ++c)
+                {
+                    dq[c] = dq[c] + (bone[c] * sign) * weights[k];
+                }
+            }
+
+            F len = Lanes::Sqrt(dq[0] * dq[0] + dq[1] * dq[1] + dq[2] * dq[2] + dq[3] * dq[3]);
+            auto positive = Lanes::Less(zero, len);
+            for (unsigned int c = 0; c < 8; ++c)
+            {
+                dq[c] = Lanes::Select(positive, dq[c] / len, dq[c]);
+            }
+
+            // DQtoMat, rows of the shader's column-major matrix
+            const F x = dq[0], y = dq[1], z = dq[2], w = dq[3];
+            const F t0 = dq[7], t1 = dq[4], t2 = dq[5], t3 = dq[6];
+            const F len2 = x * x + y * y + z * z + w * w;
+
+            F d[12];
+            d[0] = w * w + x * x - y * y - z * z;
+            d[1] = two * x * y - two * w * z;
+            d[2] = two * x * z + two * w * y;
+            d[3] = zero - two * t0 * x + two * w * t1 - two * t2 * z + two * y * t3;
+            d[4] = two * x * y + two * w * z;
+            d[5] = w * w + y * y - x * x - z * z;
+            d[6] = two * y * z - two * w * x;
+            d[7] = zero - two * t0 * y + two * t1 * z - two * x * t3 + two * w * t2;
+            d[8] = two * x * z - two * w * y;
+            d[9] = two * y * z + two * w * x;
+            d[10] = w * w + z * z - x * x - y * y;
+            d[11] = zero - two * t0 * z + two * x * t2 + two * w * t3 - two * t1 * y;
+
+            for (unsigned int c = 0; c < 12; ++c)
+            {
+                d[c] = d[c] / len2;
+                m[c] = useMatrices ? lbsRatio * m[c] + ratio * d[c] : d[c];
+            }
+        }
+
+        const F px = Lanes::Load(&i_streams.px[v]);
+        const F py = Lanes::Load(&i_streams.py[v]);
+        const F pz = Lanes::Load(&i_streams.pz[v]);
+        Lanes::Store(&io_output.px[v], m[0] * px + m[1] * py + m[2] * pz + m[3]);
+        Lanes::Store(&io_output.py[v], m[4] * px + m[5] * py + m[6] * pz + m[7]);
+        Lanes::Store(&io_output.pz[v], m[8] * px + m[9] * py + m[10] * pz + m[11]);
+
+        const F nx = Lanes::Load(&i_streams.nx[v]);
+        const F ny = Lanes::Load(&i_streams.ny[v]);
+        const F nz = Lanes::Load(&i_streams.nz[v]);
+        if (!useMatrices)
+        {
+            // a normalized dual quaternion gives a pure rotation, its inverse transpose is itself
+            Lanes::Store(&io_output.nx[v], m[0] * nx + m[1] * ny + m[2] * nz);
+            Lanes::Store(&io_output.ny[v], m[4] * nx + m[5] * ny + m[6] * nz);
+            Lanes::Store(&io_output.nz[v], m[8] * nx + m[9] * ny + m[10] * nz);
+            continue;
+        }
+
+        // inverse transpose of the upper 3x3 (rows a, b, c): cofactor rows b x c, c x a, a x b
+        // divided by the determinant, taken along the first column like CofactorNormal so near
+        // singular blends round the same way
+        const F c0x = m[5] * m[10] - m[6] * m[9];
+        const F c0y = m[6] * m[8] - m[4] * m[10];
+        const F c0z = m[4] * m[9] - m[5] * m[8];
+        const F c1x = m[9] * m[2] - m[10] * m[1];
+        const F c1y = m[10] * m[0] - m[8] * m[2];
+        const F c1z = m[8] * m[1] - m[9] * m[0];
+        const F c2x = m[1] * m[6] - m[2] * m[5];
+        const F c2y = m[2] * m[4] - m[0] * m[6];
+        const F c2z = m[0] * m[5] - m[1] * m[4];
+        const F det = m[0] * c0x + m[4] * c1x + m[8] * c2x;
+
+        Lanes::Store(&io_output.nx[v], (c0x * nx + c0y * ny + c0z * nz) / det);
+        Lanes::Store(&io_output.ny[v], (c1x * nx + c1y * ny + c1z * nz) / det);
+        Lanes::Store(&io_output.nz[v], (c2x * nx + c2y * ny + c2z * nz) / det);
+    }
+}
+
+//----------------------------------------------------------------
+
+// picks the bone data streams the encoding fills
+template <typename Lanes>
+void SkinStreamRange(const SkinningStreams& i_streams, const SkinningPalette& i_palette,
+                     SkinningMode i_mode, float i_ratio, unsigned int i_begin, unsigned int i_end,
+                     SkinnedStreams& io_output)
+{
+    const unsigned char* boneIds8[NUM_BONES_PER_VERTEX];
+    const unsigned short* boneIds16[NUM_BONES_PER_VERTEX];
+    for (unsigned int k = 0; k < NUM_BONES_PER_VERTEX; ++k)
+    {
+        boneIds8[k] = i_streams.boneIds8[k].data();
+        boneIds16[k] = i_streams.boneIds16[k].data();
+    }
+    const unsigned char* weights8[NUM_BONES_PER_VERTEX - 1];
+    const unsigned short* weights16[NUM_BONES_PER_VERTEX - 1];
+    for (unsigned int k = 0; k + 1 < NUM_BONES_PER_VERTEX; ++k)
+    {
+        weights8[k] = i_streams.weights8[k].data();
+        weights16[k] = i_streams.weights16[k].data();
+    }
+
+    const BoneEncoding& encoding = i_streams.encoding;
+    if (encoding.wideIndices && encoding.wideWeights)
+    {
+        SkinStreamBlocks<Lanes>(i_streams, boneIds16, weights16, i_palette, i_mode, i_ratio,
+                                i_begin, i_end, io_output);
+    }
+    else if (encoding.wideIndices)
+    {
+        SkinStreamBlocks<Lanes>(i_streams, boneIds16, weights8, i_palette, i_mode, i_ratio,
+                                i_begin, i_end, io_output);
+    }
+    else if (encoding.wideWeights)
+    {
+        SkinStreamBlocks<Lanes>(i_streams, boneIds8, weights16, i_palette, i_mode, i_ratio,
+                                i_begin, i_end, io_output);
+    }
+    else
+    {
+        SkinStreamBlocks<Lanes>(i_streams, boneIds8, weights8, i_palette, i_mode, i_ratio,
+                                i_begin, i_end, io_output);
+    }
+}
@@ -0,0 +1,430 @@
+#include "SkinningKernel.inl"
+#include "Skinning.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+namespace
+{
+// one vertex per iteration, the reference for the vectorized kernels
+struct ScalarLanes
+{
+    static constexpr unsigned int WIDTH = 1;
+    typedef float F;
+    typedef bool Mask;
+
+    static F Set1(float i_value)
+    {
+        return i_value;
+    }
+
+    static F Load(const float* i_source)
+    {
+        return *i_source;
+    }
+
+    // weights are divided like DecodeBoneData does, so the results match the reference exactly
+    static F LoadUnorm(const unsigned char* i_source, F i_maxWeight)
+    {
+        return *i_source / i_maxWeight;
+    }
+
+    static F LoadUnorm(const unsigned short* i_source, F i_maxWeight)
+    {
+        return *i_source / i_maxWeight;
+    }
+
+    static void Store(float* o_destination, F i_value)
+    {
+        *o_destination = i_value;
+    }
+
+    static F Gather(const float* i_base, const int* i_offsets)
+    {
+        return i_base[i_offsets[0]];
+    }
+
+    static Mask Less(F i_a, F i_b)
+    {
+        return i_a < i_b;
+    }
+
+    static F Select(Mask i_mask, F i_a, F i_b)
+    {
+        return i_mask ? i_a : i_b;
+    }
+
+    static F Sqrt(F i_value)
+    {
+        return std::sqrt(i_value);
+    }
+};
+
+//----------------------------------------------------------------
+
+SimdLevel DetectSimdLevel()
+{
+    bool sse41 = false;
+    bool avx2 = false;
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+    sse41 = __builtin_cpu_supports("sse4.1");
+    avx2 = __builtin_cpu_supports("avx2");
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    int info[4];
+    __cpuid(info, 0);
+    const int numIds = info[0];
+
+    __cpuid(info, 1);
+    sse41 = (info[2] & (1 << 19)) != 0;
+    // AVX needs the OS to save the ymm registers
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    const bool ymmSaved = osxsave && (_xgetbv(0) & 6) == 6;
+
+    if (numIds >= 7 && avx && ymmSaved)
+    {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0;
+    }
+#endif
+
+    if (avx2 && HasAVX2Kernel())
+    {
+        return SimdLevel::AVX2;
+    }
+    if (sse41 && HasSSE41Kernel())
+    {
+        return SimdLevel::SSE41;
+    }
+    return SimdLevel::Scalar;
+}
+
+//----------------------------------------------------------------
+
+const SkinningMode SKINNING_MODES[] = {SkinningMode::LBS, SkinningMode::DQS,
+                                       SkinningMode::Hybrid};
+
+// the influences a kernel reads for a vertex of a block with i_numInfluences: the last of them
+// takes what the others leave of 1, the ones after it are skipped
+VertexBoneData readInfluences(const VertexBoneData& i_boneData, unsigned int i_numInfluences)
+{
+    VertexBoneData boneData = i_boneData;
+    float remaining = 1.0f;
+    for (unsigned int i = 0; i + 1 < i_numInfluences; ++i)
+    {
+        remaining -= boneData.Weights[i];
+    }
+    boneData.Weights[i_numInfluences - 1] = remaining;
+    for (unsigned int i = i_numInfluences; i < NUM_BONES_PER_VERTEX; ++i)
+    {
+        boneData.BoneIDs[i] = 0;
+        boneData.Weights[i] = 0.0f;
+    }
+    return boneData;
+}
+
+//----------------------------------------------------------------
+
+// largest distance between the skinned streams and the reference, relative to its length
+float maxRelativeError(const std::vector<float>& i_x, const std::vector<float>& i_y,
+                       const std::vector<float>& i_z, unsigned int i_first,
+                       const std::vector<glm::vec3>& i_reference)
+{
+    float error = 0.0f;
+    for (unsigned int i = 0; i < i_reference.size(); ++i)
+    {
+        const unsigned int v = i_first + i;
+        const glm::vec3 skinned(i_x[v], i_y[v], i_z[v]);
+        const float length = std::max(glm::length(i_reference[i]), 1.0f);
+        error = std::max(error, glm::length(skinned - i_reference[i]) / length);
+    }
+    return error;
+}
+} // namespace
+
+//----------------------------------------------------------------
+
+SimdLevel GetSimdLevel()
+{
+    static const SimdLevel level = DetectSimdLevel();
+    return level;
+}
+
+//----------------------------------------------------------------
+
+const char* GetSimdLevelName(SimdLevel i_level)
+{
+    switch (i_level)
+    {
+    case SimdLevel::AVX2:
+        return "AVX2";
+    case SimdLevel::SSE41:
+        return "SSE4.1";
+    default:
+        return "scalar";
+    }
+}
+
+//----------------------------------------------------------------
+
+unsigned int AppendSkinningStreams(const Mesh& i_mesh, SkinningStreams& io_streams)
+{
+    const std::vector<Vertex>& vertices = i_mesh.GetVertices();
+    const std::vector<VertexBoneData>& boneData = i_mesh.GetVertexBoneData();
+    const std::vector<unsigned char>& packed = i_mesh.GetPackedBoneData();
+    const BoneEncoding& encoding = i_mesh.GetBoneEncoding();
+    assert(vertices.size() == boneData.size() &&
+           packed.size() == vertices.size() * encoding.GetStride());
+
+    const unsigned int first = io_streams.GetSize();
+    if (first == 0)
+    {
+        io_streams.encoding = encoding;
+    }
+    assert(io_streams.encoding.wideIndices == encoding.wideIndices &&
+           io_streams.encoding.wideWeights == encoding.wideWeights);
+
+    const unsigned int count = static_cast<unsigned int>(vertices.size());
+    const unsigned int padded =
+        (count + SKINNING_MAX_LANES - 1) / SKINNING_MAX_LANES * SKINNING_MAX_LANES;
+
+    io_streams.px.resize(first + padded, 0.0f);
+    io_streams.py.resize(first + padded, 0.0f);
+    io_streams.pz.resize(first + padded, 0.0f);
+    io_streams.nx.resize(first + padded, 0.0f);
+    io_streams.ny.resize(first + padded, 0.0f);
+    io_streams.nz.resize(first + padded, 1.0f);
+    for (unsigned int k = 0; k < NUM_BONES_PER_VERTEX; ++k)
+    {
+        // padding vertices only have the implied weight, on bone 0, so the kernels never divide
+        // by zero on them
+        if (encoding.wideIndices)
+        {
+            io_streams.boneIds16[k].resize(first + padded, 0);
+        }
+        else
+        {
+            io_streams.boneIds8[k].resize(first + padded, 0);
+        }
+    }
+    for (unsigned int k = 0; k + 1 < NUM_BONES_PER_VERTEX; ++k)
+    {
+        if (encoding.wideWeights)
+        {
+            io_streams.weights16[k].resize(first + padded, 0);
+        }
+        else
+        {
+            io_streams.weights8[k].resize(first + padded, 0);
+        }
+    }
+    io_streams.blockInfluences.resize((first + padded) / SKINNING_MAX_LANES, 1);
+
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        const unsigned int v = first + i;
+        io_streams.px[v] = vertices[i].Position.x;
+        io_streams.py[v] = vertices[i].Position.y;
+        io_streams.pz[v] = vertices[i].Position.z;
+        io_streams.nx[v] = vertices[i].Normal.x;
+        io_streams.ny[v] = vertices[i].Normal.y;
+        io_streams.nz[v] = vertices[i].Normal.z;
+
+        // same layout as EncodeBoneData writes
+        const unsigned char* vertex = &packed[i * encoding.GetStride()];
+        const unsigned char* weights = vertex + encoding.GetWeightsOffset();
+        for (unsigned int k = 0; k < NUM_BONES_PER_VERTEX; ++k)
+        {
+            if (encoding.wideIndices)
+            {
+                memcpy(&io_streams.boneIds16[k][v], vertex + 2 * k, sizeof(unsigned short));
+            }
+            else
+            {
+                io_streams.boneIds8[k][v] = vertex[k];
+            }
+        }
+        for (unsigned int k = 0; k + 1 < NUM_BONES_PER_VERTEX; ++k)
+        {
+            if (encoding.wideWeights)
+            {
+                memcpy(&io_streams.weights16[k][v], weights + 2 * k, sizeof(unsigned short));
+            }
+            else
+            {
+                io_streams.weights8[k][v] = weights[k];
+            }
+        }
+
+        unsigned int& blockInfluences = io_streams.blockInfluences[v / SKINNING_MAX_LANES];
+        blockInfluences = std::max(
+            blockInfluences,
+            GetBucketInfluences(GetInfluenceBucket(boneData[i].GetNumInfluences())));
+    }
+    return first;
+}
+
+//----------------------------------------------------------------
+
+void ResizeSkinnedStreams(const SkinningStreams& i_streams, SkinnedStreams& io_output)
+{
+    const unsigned int size = i_streams.GetSize();
+    io_output.px.resize(size);
+    io_output.py.resize(size);
+    io_output.pz.resize(size);
+    io_output.nx.resize(size);
+    io_output.ny.resize(size);
+    io_output.nz.resize(size);
+}
+
+//----------------------------------------------------------------
+
+void BuildSkinningPalette(const std::vector<glm::mat4>& i_transforms,
+                          const std::vector<glm::fdualquat>& i_dqs, SkinningMode i_mode,
+                          SkinningPalette& io_palette)
+{
+    if (i_mode != SkinningMode::DQS)
+    {
+        io_palette.matrices.resize(i_transforms.size() * 12);
+        for (unsigned int b = 0; b < i_transforms.size(); ++b)
+        {
+            // bone matrices are affine, the last row is always 0 0 0 1
+            float* row = &io_palette.matrices[b * 12];
+            for (unsigned int r = 0; r < 3; ++r)
+            {
+                for (unsigned int c = 0; c < 4; ++c)
+                {
+                    row[r * 4 + c] = i_transforms[b][c][r];
+                }
+            }
+        }
+    }
+
+    if (i_mode != SkinningMode::LBS)
+    {
+        io_palette.dualQuats.resize(i_dqs.size() * 8);
+        for (unsigned int b = 0; b < i_dqs.size(); ++b)
+        {
+            // same layout as glm::mat2x4_cast
+            const glm::mat2x4 dq = glm::mat2x4_cast(i_dqs[b]);
+            float* out = &io_palette.dualQuats[b * 8];
+            for (unsigned int c = 0; c < 4; ++c)
+            {
+                out[c] = dq[0][c];
+                out[4 + c] = dq[1][c];
+            }
+        }
+    }
+}
+
+//----------------------------------------------------------------
+
+void SkinStreams(const SkinningStreams& i_streams, const SkinningPalette& i_palette,
+                 SkinningMode i_mode, float i_ratio, unsigned int i_begin, unsigned int i_end,
+                 SkinnedStreams& io_output, SimdLevel i_level)
+{
+    assert(i_begin % SKINNING_MAX_LANES == 0 && i_end % SKINNING_MAX_LANES == 0);
+    assert(i_end <= i_streams.GetSize() && io_output.px.size() >= i_end);
+
+    switch (i_level)
+    {
+    case SimdLevel::AVX2:
+        SkinStreamsAVX2(i_streams, i_palette, i_mode, i_ratio, i_begin, i_end, io_output);
+        break;
+    case SimdLevel::SSE41:
+        SkinStreamsSSE41(i_streams, i_palette, i_mode, i_ratio, i_begin, i_end, io_output);
+        break;
+    default:
+        SkinStreamsScalar(i_streams, i_palette, i_mode, i_ratio, i_begin, i_end, io_output);
+        break;
+    }
+}
+
+//----------------------------------------------------------------
+
+void SkinStreamsScalar(const SkinningStreams& i_streams, const SkinningPalette& i_palette,
+                       SkinningMode i_mode, float i_ratio, unsigned int i_begin,
+                       unsigned int i_end, SkinnedStreams& io_output)
+{
+    SkinStreamRange<ScalarLanes>(i_streams, i_palette, i_mode, i_ratio, i_begin, i_end,
+                                 io_output);
+}
+
+//----------------------------------------------------------------
+
+bool CheckSkinningKernels(const std::vector<Mesh>& i_meshes,
+                          const std::vector<glm::mat4>& i_transforms,
+                          const std::vector<glm::fdualquat>& i_dqs, float i_ratio)
+{
+    SkinningStreams streams;
+    std::vector<unsigned int> firstVertices;
+    // the bone data as the kernels read it: decoded from the vertex buffer like SkinMesh does, up
+    // to the influence count of the block
+    std::vector<std::vector<VertexBoneData>> boneData(i_meshes.size());
+    for (unsigned int m = 0; m < i_meshes.size(); ++m)
+    {
+        const Mesh& mesh = i_meshes[m];
+        firstVertices.push_back(AppendSkinningStreams(mesh, streams));
+
+        const BoneEncoding& encoding = mesh.GetBoneEncoding();
+        const std::vector<unsigned char>& packed = mesh.GetPackedBoneData();
+        boneData[m].resize(mesh.GetVertices().size());
+        for (unsigned int v = 0; v < boneData[m].size(); ++v)
+        {
+            const unsigned int block = (firstVertices[m] + v) / SKINNING_MAX_LANES;
+            boneData[m][v] =
+                readInfluences(DecodeBoneData(&packed[v * encoding.GetStride()], encoding),
+                               streams.blockInfluences[block]);
+        }
+    }
+
+    SkinnedStreams output;
+    ResizeSkinnedStreams(streams, output);
+    SkinningPalette palette;
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    bool passed = true;
+
+    for (SkinningMode mode : SKINNING_MODES)
+    {
+        BuildSkinningPalette(i_transforms, i_dqs, mode, palette);
+        for (unsigned int l = 0; l <= static_cast<unsigned int>(GetSimdLevel()); ++l)
+        {
+            const SimdLevel level = static_cast<SimdLevel>(l);
+            SkinStreams(streams, palette, mode, i_ratio, 0, streams.GetSize(), output, level);
+
+            float positionError = 0.0f;
+            float normalError = 0.0f;
+            for (unsigned int m = 0; m < i_meshes.size(); ++m)
+            {
+                SkinVertices(i_meshes[m].GetVertices(), boneData[m], i_transforms, i_dqs, mode,
+                             i_ratio, positions, normals);
+                positionError = std::max(positionError,
+                                         maxRelativeError(output.px, output.py, output.pz,
+                                                          firstVertices[m], positions));
+                normalError = std::max(normalError,
+                                       maxRelativeError(output.nx, output.ny, output.nz,
+                                                        firstVertices[m], normals));
+            }
+
+            const bool ok = positionError <= SKINNING_KERNEL_TOLERANCE &&
+                            normalError <= SKINNING_KERNEL_TOLERANCE;
+            std::cout << "[SkinningSIMD] " << GetSimdLevelName(level) << " kernel, "
+                      << GetSkinningDefine(mode) << ": max relative error " << positionError
+                      << " position, " << normalError << " normal"
+                      << (ok ? "" : ", above the tolerance") << std::endl;
+            passed = passed && ok;
+        }
+    }
+    return passed;
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "MeshData.inl"
+
+#include <glm.hpp>
+#define GLM_ENABLE_EXPERIMENTAL
+#include <gtx/dual_quaternion.hpp>
+
+#include <vector>
+
+// Widest kernel, streams are padded to a multiple of this many vertices
+#define SKINNING_MAX_LANES 8
+// Largest error CheckSkinningKernels accepts, relative to the length of the reference (at least 1)
+#define SKINNING_KERNEL_TOLERANCE 1e-6f
+
+class Mesh;
+
+//------------------------------------------------------
+// SIMD LEVEL
+//------------------------------------------------------
+
+enum class SimdLevel
+{
+    Scalar,
+    SSE41,
+    AVX2
+};
+
+// best kernel the CPU (and the build) supports, detected once
+SimdLevel GetSimdLevel();
+
+const char* GetSimdLevelName(SimdLevel i_level);
+
+//------------------------------------------------------
+// SKINNING STREAMS
+//------------------------------------------------------
+
+// Vertex data as structure of arrays, so a kernel loads 4 or 8 vertices per instruction. Every
+// appended mesh starts on a multiple of SKINNING_MAX_LANES vertices, the padding vertices are
+// fully weighted to bone 0. Meshes sorted by influence bucket (Mesh::PartitionInfluences) give
+// blocks that mostly share one bucket.
+// The bone data is copied from the vertex buffer of the meshes (Mesh::GetPackedBoneData), so the
+// kernels skin the same quantized weights as the GPU. Only the 8-bit or the 16-bit streams are
+// filled, as the BoneEncoding of the meshes says, and the kernels widen them on load. The weight
+// of the last slot is implied: the last influence a kernel reads takes what the others leave of 1.
+struct SkinningStreams
+{
+    std::vector<float> px, py, pz;
+    std::vector<float> nx, ny, nz;
+    // shared by every mesh, taken from the first one appended
+    BoneEncoding encoding;
+    std::vector<unsigned char> boneIds8[NUM_BONES_PER_VERTEX];
+    std::vector<unsigned short> boneIds16[NUM_BONES_PER_VERTEX];
+    // unorm8 or unorm16, of BoneEncoding::GetMaxWeight
+    std::vector<unsigned char> weights8[NUM_BONES_PER_VERTEX - 1];
+    std::vector<unsigned short> weights16[NUM_BONES_PER_VERTEX - 1];
+    // influences the kernels read for each block of SKINNING_MAX_LANES vertices: the bucket size
+    // of the block's highest vertex
+    std::vector<unsigned int> blockInfluences;
+
+    unsigned int GetSize() const
+    {
+        return static_cast<unsigned int>(px.size());
+    }
+};
+
+// Skinned positions and normals, indexed like the SkinningStreams they were computed from
+struct SkinnedStreams
+{
+    std::vector<float> px, py, pz;
+    std::vector<float> nx, ny, nz;
+};
+
+// Bone palette in the layout the kernels gather from: 3x4 row-major matrices (12 floats per
+// bone) and dual quaternions as real xyzw, dual xyzw (8 floats per bone)
+struct SkinningPalette
+{
+    std::vector<float> matrices;
+    std::vector<float> dualQuats;
+};
+
+// append the vertices and the packed bone data of a mesh, returns the index of its first vertex
+// in the streams. Every mesh has to use the same BoneEncoding, see Model::processMesh.
+unsigned int AppendSkinningStreams(const Mesh& i_mesh, SkinningStreams& io_streams);
+
+// size the output like the streams, only allocates when the streams grew
+void ResizeSkinnedStreams(const SkinningStreams& i_streams, SkinnedStreams& io_output);
+
+// repack the palettes of Model::BoneTransform, only the ones the mode reads
+void BuildSkinningPalette(const std::vector<glm::mat4>& i_transforms,
+                          const std::vector<glm::fdualquat>& i_dqs, SkinningMode i_mode,
+                          SkinningPalette& io_palette);
+
+// skin the vertices [i_begin, i_end) with the same math as the CPU reference in Skinning.h.
+// Both bounds have to be multiples of SKINNING_MAX_LANES (or the stream size).
+void SkinStreams(const SkinningStreams& i_streams, const SkinningPalette& i_palette,
+                 SkinningMode i_mode, float i_ratio, unsigned int i_begin, unsigned int i_end,
+                 SkinnedStreams& io_output, SimdLevel i_level = GetSimdLevel());
+
+// kernels of the individual instruction sets, SkinStreams picks one of them
+void SkinStreamsScalar(const SkinningStreams& i_streams, const SkinningPalette& i_palette,
+                       SkinningMode i_mode, float i_ratio, unsigned int i_begin,
+                       unsigned int i_end, SkinnedStreams& io_output);
+
+void SkinStreamsSSE41(const SkinningStreams& i_streams, const SkinningPalette& i_palette,
+                      SkinningMode i_mode, float i_ratio, unsigned int i_begin,
+                      unsigned int i_end, SkinnedStreams& io_output);
+
+void SkinStreamsAVX2(const SkinningStreams& i_streams, const SkinningPalette& i_palette,
+                     SkinningMode i_mode, float i_ratio, unsigned int i_begin, unsigned int i_end,
+                     SkinnedStreams& io_output);
+
+// whether the SSE4.1 / AVX2 kernels were compiled with their instruction set. Without it they
+// forward to the scalar kernel.
+bool HasSSE41Kernel();
+bool HasAVX2Kernel();
+
+// Self-test of the kernels on real meshes: every level up to GetSimdLevel() skins the meshes in
+// every SkinningMode and is compared against SkinVertices (Skinning.h) on the bone data decoded
+// from the vertex buffers, as SkinMesh does. Logs the largest error of each run and returns
+// false if one exceeds SKINNING_KERNEL_TOLERANCE relative to the reference. The palettes have to
+// hold both the matrices and the dual quaternions, as Model::BoneTransform fills them for the
+// hybrid mode.
+bool CheckSkinningKernels(const std::vector<Mesh>& i_meshes,
+                          const std::vector<glm::mat4>& i_transforms,
+                          const std::vector<glm::fdualquat>& i_dqs, float i_ratio);
@@ -0,0 +1,123 @@
+#include "SkinningKernel.inl"
+
+#include <cstring>
+
+// MSVC has no SSE4.1 switch, the intrinsics are always available on x86
+#if defined(__SSE4_1__) || (defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86)))
+#define SKINNING_SSE41 1
+#include <smmintrin.h>
+#endif
+
+#if SKINNING_SSE41
+namespace
+{
+// four vertices per iteration
+struct SSE41Lanes
+{
+    static constexpr unsigned int WIDTH = 4;
+    typedef __m128 Mask;
+
+    struct F
+    {
+        __m128 v;
+    };
+
+    friend F operator+(F i_a, F i_b)
+    {
+        return {_mm_add_ps(i_a.v, i_b.v)};
+    }
+
+    friend F operator-(F i_a, F i_b)
+    {
+        return {_mm_sub_ps(i_a.v, i_b.v)};
+    }
+
+    friend F operator*(F i_a, F i_b)
+    {
+        return {_mm_mul_ps(i_a.v, i_b.v)};
+    }
+
+    friend F operator/(F i_a, F i_b)
+    {
+        return {_mm_div_ps(i_a.v, i_b.v)};
+    }
+
+    static F Set1(float i_value)
+    {
+        return {_mm_set1_ps(i_value)};
+    }
+
+    static F Load(const float* i_source)
+    {
+        return {_mm_loadu_ps(i_source)};
+    }
+
+    static F LoadUnorm(const unsigned char* i_source, F i_maxWeight)
+    {
+        int bytes;
+        memcpy(&bytes, i_source, sizeof(bytes));
+        const __m128i values = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(bytes));
+        return {_mm_div_ps(_mm_cvtepi32_ps(values), i_maxWeight.v)};
+    }
+
+    static F LoadUnorm(const unsigned short* i_source, F i_maxWeight)
+    {
+        const __m128i values =
+            _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(i_source)));
+        return {_mm_div_ps(_mm_cvtepi32_ps(values), i_maxWeight.v)};
+    }
+
+    static void Store(float* o_destination, F i_value)
+    {
+        _mm_storeu_ps(o_destination, i_value.v);
+    }
+
+    // no gather instruction before AVX2
+    static F Gather(const float* i_base, const int* i_offsets)
+    {
+        return {_mm_setr_ps(i_base[i_offsets[0]], i_base[i_offsets[1]], i_base[i_offsets[2]],
+                            i_base[i_offsets[3]])};
+    }
+
+    static Mask Less(F i_a, F i_b)
+    {
+        return _mm_cmplt_ps(i_a.v, i_b.v);
+    }
+
+    static F Select(Mask i_mask, F i_a, F i_b)
+    {
+        return {_mm_blendv_ps(i_b.v, i_a.v, i_mask)};
+    }
+
+    static F Sqrt(F i_value)
+    {
+        return {_mm_sqrt_ps(i_value.v)};
+    }
+};
+} // namespace
+#endif
+
+//----------------------------------------------------------------
+
+bool HasSSE41Kernel()
+{
+#if SKINNING_SSE41
+    return true;
+#else
+    return false;
+#endif
+}
+
+//----------------------------------------------------------------
+
+void SkinStreamsSSE41(const SkinningStreams& i_streams, const SkinningPalette& i_palette,
+                      SkinningMode i_mode, float i_ratio, unsigned int i_begin,
+                      unsigned int i_end, SkinnedStreams& io_output)
+{
+#if SKINNING_SSE41
+    SkinStreamRange<SSE41Lanes>(i_streams, i_palette, i_mode, i_ratio, i_begin, i_end,
+                                io_output);
+#else
+    SkinStreamsScalar(i_streams, i_palette, i_mode, i_ratio, i_begin, i_end, io_output);
+#endif
+}
@@ -0,0 +1,98 @@
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+//----------------------------------------------------------------
+
+WorkerPool::WorkerPool(unsigned int i_numWorkers)
+{
+    if (i_numWorkers == 0)
+    {
+        i_numWorkers = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // the calling thread is worker 0
+    for (unsigned int i = 1; i < i_numWorkers; ++i)
+    {
+        m_threads.emplace_back(&WorkerPool::workerLoop, this, i);
+    }
+}
+
+//----------------------------------------------------------------
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_wake.notify_all();
+
+    for (std::thread& thread : m_threads)
+    {
+        thread.join();
+    }
+}
+
+//----------------------------------------------------------------
+
+void WorkerPool::Run(unsigned int i_numTasks, TaskFunction i_function, void* i_context)
+{
+    if (i_numTasks == 0)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_function = i_function;
+        m_context = i_context;
+        m_numTasks = i_numTasks;
+        m_nextTask.store(0);
+        m_busy = static_cast<unsigned int>(m_threads.size());
+        ++m_generation;
+    }
+    m_wake.notify_all();
+
+    runTasks(0);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [this] { return m_busy == 0; });
+}
+
+//----------------------------------------------------------------
+
+void WorkerPool::workerLoop(unsigned int i_worker)
+{
+    unsigned int generation = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [&] { return m_quit || m_generation != generation; });
+            if (m_quit)
+            {
+                return;
+            }
+            generation = m_generation;
+        }
+
+        runTasks(i_worker);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (--m_busy == 0)
+        {
+            m_done.notify_one();
+        }
+    }
+}
+
+//----------------------------------------------------------------
+
+void WorkerPool::runTasks(unsigned int i_worker)
+{
+    for (unsigned int task = m_nextTask++; task < m_numTasks; task = m_nextTask++)
+    {
+        m_function(m_context, task, i_worker);
+    }
+}
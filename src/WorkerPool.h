@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//------------------------------------------------------
+// WORKER POOL CLASS
+//------------------------------------------------------
+
+// Fixed set of threads running batches of indexed tasks. Tasks are handed out through an atomic
+// counter, so a batch costs no allocation and no lock per task. The calling thread works on the
+// batch as worker 0.
+class WorkerPool
+{
+  public:
+    typedef void (*TaskFunction)(void* i_context, unsigned int i_task, unsigned int i_worker);
+
+    // Ctor, 0 threads means one worker per hardware thread
+    explicit WorkerPool(unsigned int i_numWorkers = 0);
+
+    WorkerPool(const WorkerPool& i_pool) = delete;
+    WorkerPool& operator=(const WorkerPool& i_pool) = delete;
+
+    // Dtor, joins the threads
+    ~WorkerPool();
+
+    // run i_function for every task in [0, i_numTasks), returns once all of them are done
+    void Run(unsigned int i_numTasks, TaskFunction i_function, void* i_context);
+
+    // number of workers including the calling thread
+    unsigned int GetNumWorkers() const
+    {
+        return static_cast<unsigned int>(m_threads.size()) + 1;
+    }
+
+  private:
+    void workerLoop(unsigned int i_worker);
+
+    // take tasks until the batch is exhausted
+    void runTasks(unsigned int i_worker);
+
+    std::vector<std::thread> m_threads;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+    // bumped for every batch, workers wait for a generation they have not run yet
+    unsigned int m_generation = 0;
+    // threads still working on the current batch
+    unsigned int m_busy = 0;
+    bool m_quit = false;
+
+    TaskFunction m_function = nullptr;
+    void* m_context = nullptr;
+    unsigned int m_numTasks = 0;
+    std::atomic<unsigned int> m_nextTask{0};
+};